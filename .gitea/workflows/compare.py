@@ -1,6 +1,32 @@
 import json
+import re
 import sys
 
+# Benchmarks renamed since baseline.json was recorded, as (pattern, replacement)
+# pairs applied to the baseline names. Each new name runs the same queue under
+# the same load: the old fixtures split their threads evenly between producers
+# and consumers and pushed with no work in between, which is P:1/C:1/Burst:0.
+# Burst:1 adds producer work after every push and is not comparable.
+renamed = [
+    (r'^BM_LockFreeFreshQueue_PushAndPop<int>$',
+     'BM_BoostLockFreeQueue_PushAndPop<int>'),
+    (r'^BM_QueueMultiThreadFixture<int>/PushAndPop/',
+     'BM_MultiThread_PushAndPop<MutexQueue, int>/P:1/C:1/Burst:0/'),
+    (r'^BM_ThreadSafeFreshQueueMultiThreadFixture<int>/PushAndPop/',
+     'BM_MultiThread_PushAndPop<ThreadSafeFreshQueue, int>/P:1/C:1/Burst:0/'),
+    (r'^BM_ConcurrentFreshQueueMultiThreadFixture<int>/PushAndPop/',
+     'BM_MultiThread_PushAndPop<ConcurrentFreshQueue, int>/P:1/C:1/Burst:0/'),
+    (r'^BM_LockFreeFreshQueueMultiThreadFixture<int>/PushAndPop/',
+     'BM_MultiThread_PushAndPop<boost::lockfree::queue, int>/P:1/C:1/Burst:0/'),
+]
+
+
+def current_name(name):
+    for pattern, replacement in renamed:
+        name = re.sub(pattern, replacement, name)
+    return name
+
+
 if len(sys.argv) != 2:
     print('Usage: python3 compare.py <workflow_run>.json')
     sys.exit(1)
@@ -17,7 +43,12 @@ with open('baseline.json', 'r') as f:
 
 baseline_map = {}
 for benchmark in baseline_json['benchmarks']:
-    baseline_map[benchmark['name']] = benchmark['Pushes']
+    baseline_map[current_name(benchmark['name'])] = benchmark['Pushes']
+
+missing_benchmarks = [name for name in baseline_map if name not in workflow_map]
+if missing_benchmarks:
+    print('Baseline benchmarks missing from the run, not compared:')
+    print(*missing_benchmarks, sep='\n')
 
 deteriorated_benchmarks = list()
 for name, pushes in baseline_map.items():
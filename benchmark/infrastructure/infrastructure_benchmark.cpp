@@ -1,8 +1,50 @@
 #include "benchmark/benchmark.h"
 #include "infrastructure/infrastructure.h"
+#include "perfcounters.h"
+#include <array>
 #include <boost/lockfree/queue.hpp>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <tbb/concurrent_queue.h>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/task_arena.h>
+#include <unistd.h>
+
+class CountingResource : public std::pmr::memory_resource {
+public:
+  explicit CountingResource(std::pmr::memory_resource *upstream)
+      : m_upstream{upstream} {}
+
+  int64_t allocations() const noexcept { return m_allocations; }
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+    return m_upstream->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *pointer, std::size_t bytes,
+                     std::size_t alignment) override {
+    m_upstream->deallocate(pointer, bytes, alignment);
+  }
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource *m_upstream;
+  std::atomic<int64_t> m_allocations{};
+};
 
 template <typename T> void BM_Queue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
   std::queue<T> queue{};
   T value{};
   for (auto _ : state) {
@@ -18,6 +60,7 @@ BENCHMARK(BM_Queue_PushAndPop<int>);
 
 template <typename T>
 void BM_QueueOfSharedPointer_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
   std::queue<std::shared_ptr<T>> queue{};
   std::shared_ptr<T> value{};
   for (auto _ : state) {
@@ -33,6 +76,7 @@ BENCHMARK(BM_QueueOfSharedPointer_PushAndPop<int>);
 
 template <typename T>
 void BM_QueueOfSharedPointer_PushAndPopWithLock(benchmark::State &state) {
+  const PerfCounterScope perf{state};
   std::queue<std::shared_ptr<T>> queue{};
   std::shared_ptr<T> value{};
   std::mutex mutex;
@@ -53,9 +97,10 @@ void BM_QueueOfSharedPointer_PushAndPopWithLock(benchmark::State &state) {
 }
 BENCHMARK(BM_QueueOfSharedPointer_PushAndPopWithLock<int>);
 
-template <typename T>
+template <typename T, template <typename> typename Storage = InlineStorage>
 void BM_ThreadSafeFreshQueue_PushAndPop(benchmark::State &state) {
-  ThreadSafeFreshQueue<T> queue{};
+  const PerfCounterScope perf{state};
+  ThreadSafeFreshQueue<T, Storage> queue{};
   T value{};
   for (auto _ : state) {
     queue.push(T{});
@@ -66,10 +111,12 @@ void BM_ThreadSafeFreshQueue_PushAndPop(benchmark::State &state) {
       static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
 }
 BENCHMARK(BM_ThreadSafeFreshQueue_PushAndPop<int>);
+BENCHMARK(BM_ThreadSafeFreshQueue_PushAndPop<int, SharedStorage>);
 
-template <typename T>
+template <typename T, typename Stats = NoStats>
 void BM_ConcurrentFreshQueue_PushAndPop(benchmark::State &state) {
-  ConcurrentFreshQueue<T> queue{};
+  const PerfCounterScope perf{state};
+  ConcurrentFreshQueue<T, std::allocator<T>, CondVarWait, Stats> queue{};
   T value{};
   for (auto _ : state) {
     queue.push(T{});
@@ -80,14 +127,319 @@ void BM_ConcurrentFreshQueue_PushAndPop(benchmark::State &state) {
       static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
 }
 BENCHMARK(BM_ConcurrentFreshQueue_PushAndPop<int>);
+BENCHMARK(BM_ConcurrentFreshQueue_PushAndPop<int, QueueStats>);
+
+template <typename T>
+void BM_UnpooledConcurrentFreshQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  CountingResource resource{std::pmr::new_delete_resource()};
+  ConcurrentFreshQueue<T, std::pmr::polymorphic_allocator<T>> queue{
+      &resource};
+  T value{};
+  for (auto _ : state) {
+    queue.push(T{});
+    queue.waitAndPop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["Allocations"] =
+      benchmark::Counter(static_cast<double>(resource.allocations()),
+                         benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_UnpooledConcurrentFreshQueue_PushAndPop<int>);
+
+template <typename T>
+void BM_PooledConcurrentFreshQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  CountingResource resource{std::pmr::new_delete_resource()};
+  FreshNodePool pool{&resource};
+  ConcurrentFreshQueue<T, std::pmr::polymorphic_allocator<T>> queue{&pool};
+  T value{};
+  for (auto _ : state) {
+    queue.push(T{});
+    queue.waitAndPop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["Allocations"] =
+      benchmark::Counter(static_cast<double>(resource.allocations()),
+                         benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_PooledConcurrentFreshQueue_PushAndPop<int>);
+
+template <typename T>
+void BM_ThreadSafeFreshQueue_PushRangeAndPopBulk(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  ThreadSafeFreshQueue<T> queue{};
+  const auto batchSize{static_cast<std::size_t>(state.range(0))};
+  std::vector<T> batch(batchSize);
+  std::vector<T> values(batchSize);
+  for (auto _ : state) {
+    queue.pushRange(batch.begin(), batch.end());
+    queue.tryPopBulk(values.begin(), batchSize);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * batchSize),
+                         benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ThreadSafeFreshQueue_PushRangeAndPopBulk<int>)
+    ->RangeMultiplier(4)
+    ->Range(1, 1 << 10);
+
+template <typename T>
+void BM_ConcurrentFreshQueue_PushRangeAndPopBulk(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  ConcurrentFreshQueue<T> queue{};
+  const auto batchSize{static_cast<std::size_t>(state.range(0))};
+  std::vector<T> batch(batchSize);
+  std::vector<T> values(batchSize);
+  for (auto _ : state) {
+    queue.pushRange(batch.begin(), batch.end());
+    queue.tryPopBulk(values.begin(), batchSize);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * batchSize),
+                         benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ConcurrentFreshQueue_PushRangeAndPopBulk<int>)
+    ->RangeMultiplier(4)
+    ->Range(1, 1 << 10);
+
+template <typename T, std::size_t SegmentSize>
+void BM_SegmentedFreshQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  SegmentedFreshQueue<T, SegmentSize> queue{};
+  T value{};
+  for (auto _ : state) {
+    queue.push(T{});
+    queue.waitAndPop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SegmentedFreshQueue_PushAndPop<int, 64>);
+
+template <typename T, std::size_t SegmentSize>
+void BM_SegmentedFreshQueue_PushRangeAndPopBulk(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  SegmentedFreshQueue<T, SegmentSize> queue{};
+  const auto batchSize{static_cast<std::size_t>(state.range(0))};
+  std::vector<T> batch(batchSize);
+  std::vector<T> values(batchSize);
+  for (auto _ : state) {
+    queue.pushRange(batch.begin(), batch.end());
+    queue.tryPopBulk(values.begin(), batchSize);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * batchSize),
+                         benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SegmentedFreshQueue_PushRangeAndPopBulk<int, 64>)
+    ->RangeMultiplier(4)
+    ->Range(1, 1 << 10);
+
+// Drains a backlog of millions of elements, where following a node and a
+// shared_ptr per element misses the cache on nearly every pop. Filling the
+// queue is not timed.
+template <typename Queue> void BM_Drain_TryPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  Queue queue{};
+  const auto backlog{state.range(0)};
+  int value{};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int64_t i{}; i < backlog; ++i) {
+      queue.push(static_cast<int>(i));
+    }
+    state.ResumeTiming();
+    while (queue.tryPop(value)) {
+      benchmark::DoNotOptimize(value);
+    }
+  }
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * backlog),
+                         benchmark::Counter::kIsRate);
+}
+
+template <typename Queue> void BM_Drain_TryPopBulk(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  Queue queue{};
+  const auto backlog{state.range(0)};
+  std::array<int, 256> values{};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int64_t i{}; i < backlog; ++i) {
+      queue.push(static_cast<int>(i));
+    }
+    state.ResumeTiming();
+    while (queue.tryPopBulk(values.begin(), values.size()) != 0) {
+      benchmark::DoNotOptimize(values.data());
+    }
+  }
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * backlog),
+                         benchmark::Counter::kIsRate);
+}
+
+void DrainSweep(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgName("Backlog")->Arg(1 << 20)->Arg(1 << 22);
+}
+
+BENCHMARK(BM_Drain_TryPop<ThreadSafeFreshQueue<int>>)->Apply(DrainSweep);
+BENCHMARK(BM_Drain_TryPop<ConcurrentFreshQueue<int>>)->Apply(DrainSweep);
+BENCHMARK(BM_Drain_TryPop<SegmentedFreshQueue<int, 32>>)->Apply(DrainSweep);
+BENCHMARK(BM_Drain_TryPop<SegmentedFreshQueue<int, 64>>)->Apply(DrainSweep);
+BENCHMARK(BM_Drain_TryPop<SegmentedFreshQueue<int, 128>>)->Apply(DrainSweep);
+BENCHMARK(BM_Drain_TryPopBulk<ThreadSafeFreshQueue<int>>)->Apply(DrainSweep);
+BENCHMARK(BM_Drain_TryPopBulk<ConcurrentFreshQueue<int>>)->Apply(DrainSweep);
+BENCHMARK(BM_Drain_TryPopBulk<SegmentedFreshQueue<int, 64>>)
+    ->Apply(DrainSweep);
+
+// A burst that consumers cannot keep up with: the whole backlog is pushed
+// before any of it is popped, and both are timed. SpillingFreshQueue runs
+// with a MemoryLimit below the backlog, so that most of it goes through spill
+// files in the temporary directory, and with one above it as the in-memory
+// baseline. ResidentMiB is how much the resident set grew while holding the
+// backlog.
+std::size_t residentBytes() {
+  std::ifstream statm{"/proc/self/statm"};
+  std::size_t size{};
+  std::size_t resident{};
+  statm >> size >> resident;
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+template <typename Queue> void BM_Burst_PushThenDrain(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  const auto backlog{state.range(0)};
+  std::unique_ptr<Queue> queue;
+  if constexpr (std::is_constructible_v<Queue, std::filesystem::path,
+                                        std::size_t>) {
+    queue = std::make_unique<Queue>(std::filesystem::temp_directory_path(),
+                                    static_cast<std::size_t>(state.range(1)));
+  } else {
+    queue = std::make_unique<Queue>();
+  }
+  std::size_t growth{};
+  int64_t value{};
+  for (auto _ : state) {
+    auto before{residentBytes()};
+    for (int64_t i{}; i < backlog; ++i) {
+      queue->push(i);
+    }
+    auto after{residentBytes()};
+    growth = std::max(growth, after - std::min(before, after));
+    while (queue->tryPop(value)) {
+      benchmark::DoNotOptimize(value);
+    }
+  }
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * backlog),
+                         benchmark::Counter::kIsRate);
+  state.counters["ResidentMiB"] = static_cast<double>(growth) / (1 << 20);
+}
+
+BENCHMARK(BM_Burst_PushThenDrain<ThreadSafeFreshQueue<int64_t>>)
+    ->ArgNames({"Backlog"})
+    ->Arg(1 << 23)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Burst_PushThenDrain<SpillingFreshQueue<int64_t>>)
+    ->ArgNames({"Backlog", "MemoryLimit"})
+    ->Args({1 << 23, 1 << 24})
+    ->Args({1 << 23, 1 << 20})
+    ->Args({1 << 23, 1 << 16})
+    ->Unit(benchmark::kMillisecond);
+
+// Messages of 40 B to 8 KiB from a producer thread to a consumer thread,
+// either claimed, written and read in place in a FreshByteRing or each built
+// as a std::vector<char> and pushed through a bounded ThreadSafeFreshQueue.
+// The producer fills every byte; an empty message stops the consumer.
+std::vector<std::size_t> messageSizes() {
+  std::mt19937 generator{42};
+  std::uniform_int_distribution<std::size_t> size{40, 8 << 10};
+  std::vector<std::size_t> sizes(4096);
+  std::generate(sizes.begin(), sizes.end(), [&] { return size(generator); });
+  return sizes;
+}
+
+class ByteRingChannel {
+public:
+  void send(std::size_t size, std::byte fill) {
+    auto record{m_ring.claim(size)};
+    std::fill(record.begin(), record.end(), fill);
+    m_ring.commit(record);
+  }
+
+  std::size_t receive() {
+    auto record{m_ring.read()};
+    benchmark::DoNotOptimize(record.data());
+    auto size{record.size()};
+    m_ring.release();
+    return size;
+  }
+
+private:
+  FreshByteRing m_ring{1 << 20};
+};
+
+class VectorQueueChannel {
+public:
+  void send(std::size_t size, std::byte fill) {
+    m_queue.push(std::vector<char>(size, static_cast<char>(fill)));
+  }
+
+  std::size_t receive() {
+    std::vector<char> message{};
+    m_queue.waitAndPop(message);
+    benchmark::DoNotOptimize(message.data());
+    return message.size();
+  }
+
+private:
+  ThreadSafeFreshQueue<std::vector<char>> m_queue{1024};
+};
+
+template <typename Channel>
+void BM_Bytes_ProduceAndConsume(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  const auto sizes{messageSizes()};
+  Channel channel{};
+  std::thread consumer{[&] {
+    while (channel.receive() != 0) {
+    }
+  }};
+  int64_t bytes{};
+  std::size_t next{};
+  for (auto _ : state) {
+    auto size{sizes[next++ % sizes.size()]};
+    channel.send(size, static_cast<std::byte>(size));
+    bytes += static_cast<int64_t>(size);
+  }
+  channel.send(0, std::byte{});
+  consumer.join();
+  state.SetBytesProcessed(bytes);
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations()),
+                         benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_Bytes_ProduceAndConsume<ByteRingChannel>)->UseRealTime();
+BENCHMARK(BM_Bytes_ProduceAndConsume<VectorQueueChannel>)->UseRealTime();
 
 template <typename T>
 void BM_LockFreeFreshQueue_PushAndPop(benchmark::State &state) {
-  boost::lockfree::queue<int> queue{10};
+  const PerfCounterScope perf{state};
+  LockFreeFreshQueue<T, 1024> queue{};
   T value{};
   for (auto _ : state) {
     queue.push(T{});
-    queue.pop(value);
+    queue.tryPop(value);
     benchmark::DoNotOptimize(value);
   }
   state.counters["Pushes"] = benchmark::Counter(
@@ -96,122 +448,1544 @@ void BM_LockFreeFreshQueue_PushAndPop(benchmark::State &state) {
 BENCHMARK(BM_LockFreeFreshQueue_PushAndPop<int>);
 
 template <typename T>
-class BM_QueueMultiThreadFixture : public benchmark::Fixture {
-protected:
+void BM_SpscFreshQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  SpscFreshQueue<T, 1024> queue{};
+  T value{};
+  for (auto _ : state) {
+    queue.push(T{});
+    queue.tryPop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SpscFreshQueue_PushAndPop<int>);
+
+template <typename T>
+void BM_BoostLockFreeQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  boost::lockfree::queue<T> queue{10};
+  T value{};
+  for (auto _ : state) {
+    queue.push(T{});
+    queue.pop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_BoostLockFreeQueue_PushAndPop<int>);
+
+// Mixed-priority load: pushes cycle through eight levels, level 0 being the
+// most urgent. The baseline is a std::priority_queue ordered by level.
+using PrioritizedInt = std::pair<std::size_t, int>;
+using PriorityQueueOfInts =
+    std::priority_queue<PrioritizedInt, std::vector<PrioritizedInt>,
+                        std::greater<>>;
+
+template <typename T>
+void BM_PriorityFreshQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  PriorityFreshQueue<T> freshQueue{};
+  std::size_t level{};
+  T value{};
+  for (auto _ : state) {
+    freshQueue.push(T{}, level++ % 8);
+    freshQueue.tryPop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_PriorityFreshQueue_PushAndPop<int>);
+
+void BM_PriorityQueue_PushAndPopWithLock(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  PriorityQueueOfInts queue{};
+  std::mutex mutex{};
+  std::size_t level{};
+  int value{};
+  for (auto _ : state) {
+    {
+      std::lock_guard lock{mutex};
+      queue.emplace(level++ % 8, 42);
+    }
+    {
+      std::lock_guard lock{mutex};
+      value = queue.top().second;
+      queue.pop();
+    }
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_PriorityQueue_PushAndPopWithLock);
+
+template <typename T>
+void BM_TbbConcurrentQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  tbb::concurrent_queue<T> queue{};
+  T value{};
+  for (auto _ : state) {
+    queue.push(T{});
+    queue.try_pop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TbbConcurrentQueue_PushAndPop<int>);
+
+template <typename T>
+void BM_TbbConcurrentBoundedQueue_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  tbb::concurrent_bounded_queue<T> queue{};
+  T value{};
+  for (auto _ : state) {
+    queue.push(T{});
+    queue.pop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TbbConcurrentBoundedQueue_PushAndPop<int>);
+
+// Fork/join fib on FreshThreadPool: every call with n >= 2 submits one child
+// and computes the other inline, then helps run tasks until its child is done.
+// The root is injected from the benchmark thread, which also helps, so
+// range(0) workers plus one thread run tasks. Tasks counts submitted tasks per
+// second.
+int poolFib(FreshThreadPool &pool, int n) {
+  if (n < 2)
+    return n;
+  std::atomic<bool> done{};
+  int left{};
+  pool.submit([&] {
+    left = poolFib(pool, n - 1);
+    done.store(true, std::memory_order_release);
+  });
+  auto right{poolFib(pool, n - 2)};
+  pool.runUntil([&] { return done.load(std::memory_order_acquire); });
+  return left + right;
+}
+
+constexpr int64_t poolFibTasks(int n) {
+  return n < 2 ? 0 : 1 + poolFibTasks(n - 1) + poolFibTasks(n - 2);
+}
+
+void BM_FreshThreadPool_Fib(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  constexpr int n{20};
+  FreshThreadPool pool{static_cast<std::size_t>(state.range(0))};
+  for (auto _ : state) {
+    std::atomic<bool> done{};
+    int result{};
+    pool.submit([&] {
+      result = poolFib(pool, n);
+      done.store(true, std::memory_order_release);
+    });
+    pool.runUntil([&] { return done.load(std::memory_order_acquire); });
+    benchmark::DoNotOptimize(result);
+  }
+  const auto tasks{
+      static_cast<double>(state.iterations() * (poolFibTasks(n) + 1))};
+  state.counters["Tasks"] =
+      benchmark::Counter(tasks, benchmark::Counter::kIsRate);
+  state.counters["Pushes"] =
+      benchmark::Counter(tasks, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FreshThreadPool_Fib)
+    ->RangeMultiplier(2)
+    ->Range(1, 1 << 6)
+    ->UseRealTime();
+
+// Queue-independent multi-thread benchmarks. Channel gives every queue under
+// test the same push and blocking pop; queues without a blocking pop spin on
+// their try-pop.
+template <typename Queue> struct Channel {
+  Queue queue{};
+  template <typename U> void push(U &&value) {
+    queue.push(std::forward<U>(value));
+  }
+  template <typename U> void pop(U &value) { queue.waitAndPop(value); }
+};
+
+template <typename T, std::size_t Levels, typename Idle>
+struct Channel<PriorityFreshQueue<T, Levels, Idle>> {
+  PriorityFreshQueue<T, Levels, Idle> queue{};
+  template <typename U> void push(U &&value) {
+    thread_local std::size_t level{};
+    queue.push(std::forward<U>(value), level++ % Levels);
+  }
+  template <typename U> void pop(U &value) { queue.waitAndPop(value); }
+};
+
+template <typename T, typename... Options>
+struct Channel<boost::lockfree::queue<T, Options...>> {
+  boost::lockfree::queue<T, Options...> queue{10};
+  void push(const T &value) { queue.push(value); }
+  void pop(T &value) {
+    while (!queue.pop(value))
+      ;
+  }
+};
+
+template <typename T, typename Allocator>
+struct Channel<tbb::concurrent_queue<T, Allocator>> {
+  tbb::concurrent_queue<T, Allocator> queue{};
+  template <typename U> void push(U &&value) {
+    queue.push(std::forward<U>(value));
+  }
+  void pop(T &value) {
+    while (!queue.try_pop(value))
+      ;
+  }
+};
+
+template <typename T, typename Allocator>
+struct Channel<tbb::concurrent_bounded_queue<T, Allocator>> {
+  tbb::concurrent_bounded_queue<T, Allocator> queue{};
+  template <typename U> void push(U &&value) {
+    queue.push(std::forward<U>(value));
+  }
+  void pop(T &value) { queue.pop(value); }
+};
+
+// Queues run in a configuration of their own are registered under a tag type
+// whose Channel sets them up. Bounded and TryBounded cap the queue at 64
+// elements, which keeps the sweep in the full-queue regime: Bounded producers
+// wait for the low watermark, TryBounded ones retry tryPush and count failed
+// attempts as FullRejects.
+inline constexpr std::size_t BoundedCapacity{64};
+template <typename Queue> struct Bounded {};
+template <typename Queue> struct TryBounded {};
+
+template <typename Queue> struct Channel<Bounded<Queue>> {
+  Queue queue{BoundedCapacity};
+  template <typename U> void push(U &&value) {
+    queue.waitAndPush(std::forward<U>(value));
+  }
+  template <typename U> void pop(U &value) { queue.waitAndPop(value); }
+};
+
+template <typename Queue> struct Channel<TryBounded<Queue>> {
+  Queue queue{BoundedCapacity};
+  std::atomic<int64_t> rejects{};
+  template <typename U> void push(const U &value) {
+    while (!queue.tryPush(value)) {
+      rejects.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::yield();
+    }
+  }
+  template <typename U> void pop(U &value) { queue.waitAndPop(value); }
+  void report(benchmark::State &state) {
+    if (state.thread_index() == 0)
+      state.counters["FullRejects"] =
+          benchmark::Counter(static_cast<double>(rejects.exchange(0)),
+                             benchmark::Counter::kIsRate);
+  }
+};
+
+// tbb::concurrent_bounded_queue under the FreshQueue names, so that it runs
+// through the same bounded channels.
+template <typename T> class TbbBoundedQueue {
+public:
+  explicit TbbBoundedQueue(std::size_t capacity) {
+    m_queue.set_capacity(static_cast<std::ptrdiff_t>(capacity));
+  }
+  template <typename U> void waitAndPush(U &&value) {
+    m_queue.push(std::forward<U>(value));
+  }
+  template <typename U> bool tryPush(U &&value) {
+    return m_queue.try_push(std::forward<U>(value));
+  }
+  void waitAndPop(T &value) { m_queue.pop(value); }
+
+private:
+  tbb::concurrent_bounded_queue<T> m_queue{};
+};
+
+// Every push is a pushRange of Batch copies and every pop takes Batch elements
+// with waitAndPopBulk, so one push moves Batch elements.
+template <typename Queue, std::size_t Batch> struct Bulk {};
+
+template <typename Queue, std::size_t Batch>
+struct Channel<Bulk<Queue, Batch>> {
+  static constexpr int64_t ElementsPerPush{Batch};
+  Queue queue{};
+  template <typename U> void push(const U &value) {
+    std::array<U, Batch> batch{};
+    batch.fill(value);
+    queue.pushRange(batch.begin(), batch.end());
+  }
+  template <typename U> void pop(U &value) {
+    std::array<U, Batch> batch{};
+    for (std::size_t popped{}; popped < Batch;) {
+      popped += queue.waitAndPopBulk(batch.begin() + popped, Batch - popped);
+    }
+    value = batch.back();
+  }
+};
+
+// ConcurrentFreshQueue taking its nodes from a FreshNodePool, which reports
+// how often the pool went upstream as Allocations per iteration.
+template <typename T> struct PooledConcurrentFreshQueue {};
+
+template <typename T> struct Channel<PooledConcurrentFreshQueue<T>> {
+  CountingResource resource{std::pmr::new_delete_resource()};
+  FreshNodePool pool{&resource};
+  ConcurrentFreshQueue<T, std::pmr::polymorphic_allocator<T>> queue{&pool};
+  int64_t reported{};
+  template <typename U> void push(U &&value) {
+    queue.push(std::forward<U>(value));
+  }
+  template <typename U> void pop(U &value) { queue.waitAndPop(value); }
+  void report(benchmark::State &state) {
+    if (state.thread_index() != 0)
+      return;
+    const auto allocations{resource.allocations()};
+    state.counters["Allocations"] = benchmark::Counter(
+        static_cast<double>(allocations - std::exchange(reported, allocations)),
+        benchmark::Counter::kAvgIterations);
+  }
+};
+
+template <typename Adapter> constexpr int64_t elementsPerPush() {
+  if constexpr (requires { Adapter::ElementsPerPush; })
+    return Adapter::ElementsPerPush;
+  else
+    return 1;
+}
+
+// The textbook baseline: a std::queue of shared pointers behind one mutex and
+// a condition variable.
+template <typename T> class MutexQueue {
+public:
+  void push(T value) {
+    {
+      std::lock_guard lock{m_mutex};
+      m_queue.push(std::make_shared<T>(std::move(value)));
+    }
+    m_pushNotification.notify_one();
+  }
+
+  void waitAndPop(T &value) {
+    std::unique_lock lock{m_mutex};
+    m_pushNotification.wait(lock, [&] { return !m_queue.empty(); });
+    value = std::move(*m_queue.front());
+    m_queue.pop();
+  }
+
+private:
   std::queue<std::shared_ptr<T>> m_queue{};
   std::mutex m_mutex;
   std::condition_variable m_pushNotification;
 };
-BENCHMARK_TEMPLATE_DEFINE_F(BM_QueueMultiThreadFixture, PushAndPop, int)
-(benchmark::State &state) {
-  bool isPushingThread{state.thread_index() % 2 == 0};
+
+// The priority baseline: a std::priority_queue ordered by level behind one
+// mutex and a condition variable, level 0 being the most urgent.
+template <typename T> class MutexPriorityQueue {
+public:
+  static constexpr std::size_t Levels{8};
+
+  void push(T value, std::size_t level) {
+    {
+      std::lock_guard lock{m_mutex};
+      m_queue.emplace(level, std::move(value));
+    }
+    m_pushNotification.notify_one();
+  }
+
+  void waitAndPop(T &value) {
+    std::unique_lock lock{m_mutex};
+    m_pushNotification.wait(lock, [&] { return !m_queue.empty(); });
+    value = m_queue.top().second;
+    m_queue.pop();
+  }
+
+private:
+  using Prioritized = std::pair<std::size_t, T>;
+  std::priority_queue<Prioritized, std::vector<Prioritized>, std::greater<>>
+      m_queue{};
+  std::mutex m_mutex;
+  std::condition_variable m_pushNotification;
+};
+
+template <typename T> struct Channel<MutexPriorityQueue<T>> {
+  MutexPriorityQueue<T> queue{};
+  template <typename U> void push(U &&value) {
+    thread_local std::size_t level{};
+    queue.push(std::forward<U>(value), level++ % MutexPriorityQueue<T>::Levels);
+  }
+  template <typename U> void pop(U &value) { queue.waitAndPop(value); }
+};
+
+struct Payload64B {
+  std::array<std::byte, 64> bytes{};
+};
+
+struct Payload1KiB {
+  std::array<std::byte, 1024> bytes{};
+};
+
+template <typename Payload> Payload makePayload() { return Payload{}; }
+template <> int makePayload<int>() { return 42; }
+template <> std::string makePayload<std::string>() {
+  return std::string(48, 'x');
+}
+template <> std::unique_ptr<int> makePayload<std::unique_ptr<int>>() {
+  return std::make_unique<int>(42);
+}
+
+// Stands in for the work a producer does to make each element.
+void produceWork(int64_t elements) {
+  for (int64_t i{}; i < elements * 16; ++i) {
+    benchmark::DoNotOptimize(i);
+  }
+}
+
+// range(0):range(1) is the producer:consumer ratio the threads are split in,
+// with 0 standing for a single thread: 0:1 is one producer feeding every other
+// thread and 1:0 the reverse. Producers push one element per consumer thread
+// and consumers pop one per producer thread each iteration, so both sides move
+// the same total. range(2) is the burst size: producers do the same work per
+// element either way, but with bursts they push that many elements back to
+// back before working off the backlog. A burst of 0 pushes with no work in
+// between, which is how the old per-queue fixtures measured.
+template <template <typename> typename Queue, typename Payload>
+void BM_MultiThread_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  static Channel<Queue<Payload>> channel{};
+  constexpr auto batch{elementsPerPush<Channel<Queue<Payload>>>()};
+  const auto threads{static_cast<int64_t>(state.threads())};
+  const auto producerShare{state.range(0)};
+  const auto consumerShare{state.range(1)};
+  const auto producers{std::clamp<int64_t>(
+      producerShare == 0   ? 1
+      : consumerShare == 0 ? threads - 1
+                           : threads * producerShare /
+                                 (producerShare + consumerShare),
+      1, threads - 1)};
+  const auto consumers{threads - producers};
+  const auto burst{state.range(2)};
+  bool isPushingThread{state.thread_index() < producers};
   if (isPushingThread) {
+    int64_t pending{};
     for (auto _ : state) {
-      {
-        std::lock_guard lock{m_mutex};
-        m_queue.push(std::make_shared<int>(42));
+      for (int64_t i{}; i < consumers; ++i) {
+        channel.push(makePayload<Payload>());
+        if (burst != 0 && ++pending == burst) {
+          produceWork(pending * batch);
+          pending = 0;
+        }
       }
-      m_pushNotification.notify_one();
     }
     state.counters["Pushes"] = benchmark::Counter(
-        static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+        static_cast<double>(state.iterations() * consumers * batch),
+        benchmark::Counter::kIsRate);
   } else {
-    std::shared_ptr<int> value{};
+    Payload value{};
     for (auto _ : state) {
-      std::unique_lock lock{m_mutex};
-      m_pushNotification.wait(lock, [&] { return !m_queue.empty(); });
-      value = m_queue.front();
-      m_queue.pop();
-      benchmark::DoNotOptimize(value);
+      for (int64_t i{}; i < producers; ++i) {
+        channel.pop(value);
+        benchmark::DoNotOptimize(value);
+      }
     }
   }
+  if constexpr (requires { channel.report(state); })
+    channel.report(state);
 }
-BENCHMARK_REGISTER_F(BM_QueueMultiThreadFixture, PushAndPop)
-    ->ThreadRange(2, 1 << 10)
+
+void MultiThreadSweep(benchmark::internal::Benchmark *benchmark,
+                      int64_t maxThreads) {
+  benchmark->ArgNames({"P", "C", "Burst"});
+  for (auto &&[producers, consumers] :
+       {std::pair<int64_t, int64_t>{1, 1}, {0, 1}, {1, 0}}) {
+    for (auto &&burst : {1, 64}) {
+      benchmark->Args({producers, consumers, burst});
+    }
+  }
+  benchmark->Args({1, 1, 0});
+  benchmark->ThreadRange(2, maxThreads)->MeasureProcessCPUTime()->UseRealTime();
+}
+
+// int runs the full thread sweep; the larger payloads stop at 64 threads to
+// keep the matrix affordable.
+void IntSweep(benchmark::internal::Benchmark *benchmark) {
+  MultiThreadSweep(benchmark, 1 << 10);
+}
+
+void PayloadSweep(benchmark::internal::Benchmark *benchmark) {
+  MultiThreadSweep(benchmark, 1 << 6);
+}
+
+// Two threads always split into one producer and one consumer.
+void SpscSweep(benchmark::internal::Benchmark *benchmark) {
+  MultiThreadSweep(benchmark, 2);
+}
+
+BENCHMARK(BM_MultiThread_PushAndPop<MutexQueue, int>)->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<MutexQueue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<MutexQueue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<MutexQueue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<MutexQueue, std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<ThreadSafeFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ThreadSafeFreshQueue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ThreadSafeFreshQueue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ThreadSafeFreshQueue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(
+    BM_MultiThread_PushAndPop<ThreadSafeFreshQueue, std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<ConcurrentFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ConcurrentFreshQueue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ConcurrentFreshQueue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ConcurrentFreshQueue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(
+    BM_MultiThread_PushAndPop<ConcurrentFreshQueue, std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+// The same queue collecting QueueStats, to price the counters under
+// contention.
+template <typename T>
+using CountedConcurrentFreshQueue =
+    ConcurrentFreshQueue<T, std::allocator<T>, CondVarWait, QueueStats>;
+BENCHMARK(BM_MultiThread_PushAndPop<CountedConcurrentFreshQueue, int>)
+    ->Apply(IntSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<SegmentedFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<SegmentedFreshQueue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<SegmentedFreshQueue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<SegmentedFreshQueue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<SegmentedFreshQueue, std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<ShardedFreshQueue, int>)->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ShardedFreshQueue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ShardedFreshQueue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ShardedFreshQueue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<ShardedFreshQueue, std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<LockFreeFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<LockFreeFreshQueue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<LockFreeFreshQueue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<LockFreeFreshQueue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<LockFreeFreshQueue, std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<UnboundedLockFreeFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<UnboundedLockFreeFreshQueue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<UnboundedLockFreeFreshQueue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<UnboundedLockFreeFreshQueue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<UnboundedLockFreeFreshQueue,
+                                    std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+// boost::lockfree::queue only holds trivially copyable elements.
+BENCHMARK(BM_MultiThread_PushAndPop<boost::lockfree::queue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<boost::lockfree::queue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<boost::lockfree::queue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<tbb::concurrent_queue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<tbb::concurrent_queue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<tbb::concurrent_queue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<tbb::concurrent_queue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(
+    BM_MultiThread_PushAndPop<tbb::concurrent_queue, std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<tbb::concurrent_bounded_queue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<tbb::concurrent_bounded_queue, Payload64B>)
+    ->Apply(PayloadSweep);
+BENCHMARK(
+    BM_MultiThread_PushAndPop<tbb::concurrent_bounded_queue, Payload1KiB>)
+    ->Apply(PayloadSweep);
+BENCHMARK(
+    BM_MultiThread_PushAndPop<tbb::concurrent_bounded_queue, std::string>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<tbb::concurrent_bounded_queue,
+                                    std::unique_ptr<int>>)
+    ->Apply(PayloadSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<SpscFreshQueue, int>)->Apply(SpscSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<PooledConcurrentFreshQueue, int>)
+    ->Apply(IntSweep);
+
+BENCHMARK(BM_MultiThread_PushAndPop<PriorityFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<MutexPriorityQueue, int>)
+    ->Apply(IntSweep);
+
+template <typename T>
+using BoundedThreadSafeFreshQueue = Bounded<ThreadSafeFreshQueue<T>>;
+template <typename T>
+using TryBoundedThreadSafeFreshQueue = TryBounded<ThreadSafeFreshQueue<T>>;
+template <typename T>
+using BoundedConcurrentFreshQueue = Bounded<ConcurrentFreshQueue<T>>;
+template <typename T>
+using TryBoundedConcurrentFreshQueue = TryBounded<ConcurrentFreshQueue<T>>;
+template <typename T> using BoundedTbbQueue = Bounded<TbbBoundedQueue<T>>;
+template <typename T> using TryBoundedTbbQueue = TryBounded<TbbBoundedQueue<T>>;
+BENCHMARK(BM_MultiThread_PushAndPop<BoundedThreadSafeFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<TryBoundedThreadSafeFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<BoundedConcurrentFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<TryBoundedConcurrentFreshQueue, int>)
+    ->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<BoundedTbbQueue, int>)->Apply(IntSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<TryBoundedTbbQueue, int>)
+    ->Apply(IntSweep);
+
+template <typename T>
+using Bulk16ThreadSafeFreshQueue = Bulk<ThreadSafeFreshQueue<T>, 16>;
+template <typename T>
+using Bulk256ThreadSafeFreshQueue = Bulk<ThreadSafeFreshQueue<T>, 256>;
+template <typename T>
+using Bulk16ConcurrentFreshQueue = Bulk<ConcurrentFreshQueue<T>, 16>;
+template <typename T>
+using Bulk256ConcurrentFreshQueue = Bulk<ConcurrentFreshQueue<T>, 256>;
+BENCHMARK(BM_MultiThread_PushAndPop<Bulk16ThreadSafeFreshQueue, int>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<Bulk256ThreadSafeFreshQueue, int>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<Bulk16ConcurrentFreshQueue, int>)
+    ->Apply(PayloadSweep);
+BENCHMARK(BM_MultiThread_PushAndPop<Bulk256ConcurrentFreshQueue, int>)
+    ->Apply(PayloadSweep);
+
+// Pushes and pops heavy payloads on one thread and reports how often each
+// element was copied and moved on the way through the queue. Mode 0 pushes an
+// lvalue, which has to be copied once, mode 1 pushes an rvalue and mode 2
+// emplaces from constructor arguments.
+template <typename Payload> class Tallied {
+public:
+  static inline int64_t copies{};
+  static inline int64_t moves{};
+
+  Tallied() = default;
+  explicit Tallied(Payload payload) noexcept : m_payload{std::move(payload)} {}
+  Tallied(const Tallied &other) : m_payload{other.m_payload} { ++copies; }
+  Tallied(Tallied &&other) noexcept : m_payload{std::move(other.m_payload)} {
+    ++moves;
+  }
+  Tallied &operator=(const Tallied &other) {
+    m_payload = other.m_payload;
+    ++copies;
+    return *this;
+  }
+  Tallied &operator=(Tallied &&other) noexcept {
+    m_payload = std::move(other.m_payload);
+    ++moves;
+    return *this;
+  }
+  ~Tallied() = default;
+
+private:
+  Payload m_payload{};
+};
+
+template <template <typename> typename Queue, typename Payload>
+void BM_CopiesAndMoves_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  using Element = Tallied<Payload>;
+  Queue<Element> queue{};
+  const auto mode{state.range(0)};
+  const Element original{makePayload<Payload>()};
+  Element value{};
+  Element::copies = 0;
+  Element::moves = 0;
+  for (auto _ : state) {
+    if (mode == 0)
+      queue.push(original);
+    else if (mode == 1)
+      queue.push(Element{makePayload<Payload>()});
+    else
+      queue.emplace(makePayload<Payload>());
+    queue.waitAndPop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  const auto iterations{static_cast<double>(state.iterations())};
+  state.counters["Copies"] = static_cast<double>(Element::copies) / iterations;
+  state.counters["Moves"] = static_cast<double>(Element::moves) / iterations;
+  state.counters["Pushes"] =
+      benchmark::Counter(iterations, benchmark::Counter::kIsRate);
+}
+
+void CopyModes(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgName("Mode")->DenseRange(0, 2);
+}
+
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<ThreadSafeFreshQueue, Payload1KiB>)
+    ->Apply(CopyModes);
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<ThreadSafeFreshQueue, std::string>)
+    ->Apply(CopyModes);
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<ConcurrentFreshQueue, Payload1KiB>)
+    ->Apply(CopyModes);
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<ConcurrentFreshQueue, std::string>)
+    ->Apply(CopyModes);
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<SegmentedFreshQueue, Payload1KiB>)
+    ->Apply(CopyModes);
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<SegmentedFreshQueue, std::string>)
+    ->Apply(CopyModes);
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<LockFreeFreshQueue, Payload1KiB>)
+    ->Apply(CopyModes);
+BENCHMARK(BM_CopiesAndMoves_PushAndPop<LockFreeFreshQueue, std::string>)
+    ->Apply(CopyModes);
+BENCHMARK(
+    BM_CopiesAndMoves_PushAndPop<UnboundedLockFreeFreshQueue, Payload1KiB>)
+    ->Apply(CopyModes);
+BENCHMARK(
+    BM_CopiesAndMoves_PushAndPop<UnboundedLockFreeFreshQueue, std::string>)
+    ->Apply(CopyModes);
+
+// Every thread pushes and then pops. On ShardedFreshQueue that mostly stays on
+// the thread's home lane, which shows how pushes scale once threads stop
+// sharing one lock.
+template <template <typename> typename Queue>
+void BM_MultiThread_PushThenPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  static Channel<Queue<int>> channel{};
+  int value{};
+  for (auto _ : state) {
+    channel.push(42);
+    channel.pop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MultiThread_PushThenPop<ConcurrentFreshQueue>)
+    ->ThreadRange(1, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_MultiThread_PushThenPop<ShardedFreshQueue>)
+    ->ThreadRange(1, 1 << 10)
     ->MeasureProcessCPUTime()
     ->UseRealTime();
 
-template <typename T>
-class BM_ThreadSafeFreshQueueMultiThreadFixture : public benchmark::Fixture {
-protected:
-  ThreadSafeFreshQueue<T> m_queue{};
+struct alignas(64) LatencySlot {
+  int64_t totalNanoseconds{};
+  int64_t samples{};
 };
-BENCHMARK_TEMPLATE_DEFINE_F(BM_ThreadSafeFreshQueueMultiThreadFixture,
-                            PushAndPop, int)
-(benchmark::State &state) {
+
+inline int64_t nowNanoseconds() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Producers push their timestamp and consumers record the queueing delay in a
+// slot of their own; thread 0 sums the slots once every thread has passed the
+// stop barrier, and reports process CPU seconds per wall-clock second as the
+// CPU burn of the wait policy.
+template <typename Queue>
+void BM_WaitPolicy_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  static Queue queue{};
+  static std::array<LatencySlot, 1 << 10> latencies{};
+  auto &latency{latencies[static_cast<std::size_t>(state.thread_index())]};
+  latency = {};
+  const auto cpuStart{std::clock()};
+  const auto wallStart{std::chrono::steady_clock::now()};
   bool isPushingThread{state.thread_index() % 2 == 0};
   if (isPushingThread) {
     for (auto _ : state) {
-      m_queue.push(42);
+      queue.push(nowNanoseconds());
     }
     state.counters["Pushes"] = benchmark::Counter(
         static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
   } else {
-    int value{};
+    int64_t value{};
     for (auto _ : state) {
-      m_queue.waitAndPop(value);
-      benchmark::DoNotOptimize(value);
+      queue.waitAndPop(value);
+      latency.totalNanoseconds += nowNanoseconds() - value;
+      ++latency.samples;
+    }
+  }
+  if (state.thread_index() == 0) {
+    LatencySlot total{};
+    for (auto &&slot : latencies | std::views::take(state.threads())) {
+      total.totalNanoseconds += slot.totalNanoseconds;
+      total.samples += slot.samples;
     }
+    const std::chrono::duration<double> wall{std::chrono::steady_clock::now() -
+                                             wallStart};
+    state.counters["LatencyNs"] =
+        static_cast<double>(total.totalNanoseconds) /
+        static_cast<double>(std::max<int64_t>(total.samples, 1));
+    state.counters["CpuBurn"] =
+        static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC /
+        wall.count();
   }
 }
-BENCHMARK_REGISTER_F(BM_ThreadSafeFreshQueueMultiThreadFixture, PushAndPop)
+BENCHMARK(BM_WaitPolicy_PushAndPop<ThreadSafeFreshQueue<int64_t>>)
+    ->ThreadRange(2, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_WaitPolicy_PushAndPop<
+              ThreadSafeFreshQueue<int64_t, InlineStorage, BusySpinWait>>)
+    ->ThreadRange(2, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_WaitPolicy_PushAndPop<
+              ThreadSafeFreshQueue<int64_t, InlineStorage, SpinYieldWait<>>>)
+    ->ThreadRange(2, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_WaitPolicy_PushAndPop<
+              ThreadSafeFreshQueue<int64_t, InlineStorage, SpinAtomicWait<>>>)
+    ->ThreadRange(2, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_WaitPolicy_PushAndPop<ConcurrentFreshQueue<int64_t>>)
+    ->ThreadRange(2, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_WaitPolicy_PushAndPop<ConcurrentFreshQueue<
+              int64_t, std::allocator<int64_t>, BusySpinWait>>)
+    ->ThreadRange(2, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_WaitPolicy_PushAndPop<ConcurrentFreshQueue<
+              int64_t, std::allocator<int64_t>, SpinYieldWait<>>>)
+    ->ThreadRange(2, 1 << 10)
+    ->MeasureProcessCPUTime()
+    ->UseRealTime();
+BENCHMARK(BM_WaitPolicy_PushAndPop<ConcurrentFreshQueue<
+              int64_t, std::allocator<int64_t>, SpinAtomicWait<>>>)
     ->ThreadRange(2, 1 << 10)
     ->MeasureProcessCPUTime()
     ->UseRealTime();
 
-template <typename T>
-class BM_ConcurrentFreshQueueMultiThreadFixture : public benchmark::Fixture {
-protected:
-  ConcurrentFreshQueue<T> m_queue{};
+// Log-linear histogram in the spirit of HdrHistogram. Values below 64 get a
+// bucket each; above that every power of two is split into 32 buckets, so a
+// reported percentile is at most about 3% above the true value.
+class LatencyHistogram {
+public:
+  void reset() noexcept { *this = {}; }
+
+  void record(int64_t nanoseconds) noexcept {
+    auto value{static_cast<uint64_t>(std::max<int64_t>(nanoseconds, 0))};
+    ++m_counts[bucketOf(value)];
+    ++m_total;
+    m_max = std::max(m_max, value);
+  }
+
+  void merge(const LatencyHistogram &other) noexcept {
+    for (std::size_t i{}; i < Buckets; ++i) {
+      m_counts[i] += other.m_counts[i];
+    }
+    m_total += other.m_total;
+    m_max = std::max(m_max, other.m_max);
+  }
+
+  uint64_t max() const noexcept { return m_max; }
+
+  // Highest value that falls in the same bucket as the given percentile.
+  uint64_t percentile(double percent) const noexcept {
+    const auto rank{static_cast<uint64_t>(
+        std::ceil(percent / 100.0 * static_cast<double>(m_total)))};
+    uint64_t seen{};
+    for (std::size_t i{}; i < Buckets; ++i) {
+      seen += m_counts[i];
+      if (seen >= std::max<uint64_t>(rank, 1))
+        return std::min(highestInBucket(i), m_max);
+    }
+    return m_max;
+  }
+
+private:
+  static constexpr std::size_t SubBits{5};
+  static constexpr std::size_t SubBuckets{std::size_t{1} << SubBits};
+  static constexpr std::size_t Buckets{(65 - SubBits) * SubBuckets};
+
+  static std::size_t bucketOf(uint64_t value) noexcept {
+    if (value < SubBuckets)
+      return value;
+    const auto shift{static_cast<std::size_t>(std::bit_width(value)) -
+                     SubBits - 1};
+    return shift * SubBuckets + static_cast<std::size_t>(value >> shift);
+  }
+
+  static uint64_t highestInBucket(std::size_t bucket) noexcept {
+    if (bucket < 2 * SubBuckets)
+      return bucket;
+    const auto shift{bucket / SubBuckets - 1};
+    const auto top{bucket - shift * SubBuckets};
+    return ((uint64_t{top} + 1) << shift) - 1;
+  }
+
+  std::array<uint64_t, Buckets> m_counts{};
+  uint64_t m_total{};
+  uint64_t m_max{};
 };
-BENCHMARK_TEMPLATE_DEFINE_F(BM_ConcurrentFreshQueueMultiThreadFixture,
-                            PushAndPop, int)
-(benchmark::State &state) {
+
+constexpr std::size_t MaxLatencyThreads{1 << 5};
+std::array<LatencyHistogram, MaxLatencyThreads> latencyHistograms{};
+
+// Producers push their timestamp and consumers record the delay into their own
+// histogram; thread 0 merges them after the stop barrier. range(0) is the
+// offered load in pushes per second per producer, 0 meaning as fast as
+// possible. A paced producer stamps the time its push was scheduled for, so a
+// stalled queue is charged for the pushes it held up as well.
+template <typename Queue>
+void BM_Latency_PushAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  static Channel<Queue> channel{};
+  auto &histogram{latencyHistograms[static_cast<std::size_t>(
+      state.thread_index())]};
+  histogram.reset();
   bool isPushingThread{state.thread_index() % 2 == 0};
   if (isPushingThread) {
+    const auto rate{state.range(0)};
+    const std::chrono::nanoseconds interval{rate ? 1'000'000'000 / rate : 0};
+    auto scheduled{std::chrono::steady_clock::now()};
     for (auto _ : state) {
-      m_queue.push(42);
+      if (rate) {
+        scheduled += interval;
+        while (std::chrono::steady_clock::now() < scheduled)
+          std::this_thread::yield();
+        channel.push(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         scheduled.time_since_epoch())
+                         .count());
+      } else {
+        channel.push(nowNanoseconds());
+      }
     }
     state.counters["Pushes"] = benchmark::Counter(
         static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
   } else {
-    int value{};
+    int64_t timestamp{};
     for (auto _ : state) {
-      m_queue.waitAndPop(value);
-      benchmark::DoNotOptimize(value);
+      channel.pop(timestamp);
+      histogram.record(nowNanoseconds() - timestamp);
+    }
+  }
+  if (state.thread_index() == 0) {
+    LatencyHistogram total{};
+    for (auto &&threadHistogram :
+         latencyHistograms | std::views::take(state.threads())) {
+      total.merge(threadHistogram);
     }
+    auto report{[&](const char *name, uint64_t nanoseconds) {
+      state.counters[name] = static_cast<double>(nanoseconds);
+    }};
+    report("P50Ns", total.percentile(50));
+    report("P99Ns", total.percentile(99));
+    report("P999Ns", total.percentile(99.9));
+    report("MaxNs", total.max());
   }
 }
-BENCHMARK_REGISTER_F(BM_ConcurrentFreshQueueMultiThreadFixture, PushAndPop)
-    ->ThreadRange(2, 1 << 10)
+
+void LatencySweep(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgName("Rate")
+      ->Arg(0)
+      ->Arg(100'000)
+      ->ThreadRange(2, MaxLatencyThreads)
+      ->MeasureProcessCPUTime()
+      ->UseRealTime();
+}
+
+BENCHMARK(BM_Latency_PushAndPop<ThreadSafeFreshQueue<int64_t>>)
+    ->Apply(LatencySweep);
+BENCHMARK(BM_Latency_PushAndPop<ConcurrentFreshQueue<int64_t>>)
+    ->Apply(LatencySweep);
+BENCHMARK(BM_Latency_PushAndPop<ShardedFreshQueue<int64_t>>)
+    ->Apply(LatencySweep);
+BENCHMARK(BM_Latency_PushAndPop<PriorityFreshQueue<int64_t>>)
+    ->Apply(LatencySweep);
+BENCHMARK(BM_Latency_PushAndPop<LockFreeFreshQueue<int64_t>>)
+    ->Apply(LatencySweep);
+BENCHMARK(BM_Latency_PushAndPop<SpscFreshQueue<int64_t>>)
+    ->ArgName("Rate")
+    ->Arg(0)
+    ->Arg(100'000)
+    ->Threads(2)
     ->MeasureProcessCPUTime()
     ->UseRealTime();
+BENCHMARK(BM_Latency_PushAndPop<boost::lockfree::queue<int64_t>>)
+    ->Apply(LatencySweep);
+BENCHMARK(BM_Latency_PushAndPop<tbb::concurrent_queue<int64_t>>)
+    ->Apply(LatencySweep);
+BENCHMARK(BM_Latency_PushAndPop<tbb::concurrent_bounded_queue<int64_t>>)
+    ->Apply(LatencySweep);
 
-template <typename T>
-class BM_LockFreeFreshQueueMultiThreadFixture : public benchmark::Fixture {
-protected:
-  boost::lockfree::queue<int> m_queue{10};
+// Many consumers taking ElementsPerConsumer elements each from one producer.
+// BM_Consumers_WaitAndPop parks an OS thread per consumer in waitAndPop; the
+// coroutine versions suspend in asyncPop and are resumed either by the pushing
+// thread itself or on a small FreshThreadPool. Only the pushes and the wait
+// for every consumer to finish are timed; starting the consumers is not.
+constexpr int64_t ElementsPerConsumer{16};
+
+template <typename Queue>
+void BM_Consumers_WaitAndPop(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  Queue queue{};
+  const auto consumers{state.range(0)};
+  std::vector<std::thread> threads{};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int64_t i{}; i < consumers; ++i) {
+      threads.emplace_back([&] {
+        int value{};
+        for (int64_t j{}; j < ElementsPerConsumer; ++j) {
+          queue.waitAndPop(value);
+        }
+      });
+    }
+    state.ResumeTiming();
+    for (int64_t i{}; i < consumers * ElementsPerConsumer; ++i) {
+      queue.push(42);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    state.PauseTiming();
+    threads.clear();
+    state.ResumeTiming();
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * consumers * ElementsPerConsumer),
+      benchmark::Counter::kIsRate);
+}
+
+template <typename Queue, typename... Executor>
+FreshTask asyncConsume(Queue &queue, std::atomic<int64_t> &popped,
+                       Executor... executor) {
+  for (int64_t i{}; i < ElementsPerConsumer; ++i) {
+    benchmark::DoNotOptimize(co_await queue.asyncPop(executor...));
+  }
+  popped.fetch_add(ElementsPerConsumer, std::memory_order_release);
+}
+
+template <typename Queue>
+void BM_Consumers_AsyncPopInline(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  Queue queue{};
+  const auto consumers{state.range(0)};
+  std::atomic<int64_t> popped{};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int64_t i{}; i < consumers; ++i) {
+      asyncConsume(queue, popped);
+    }
+    state.ResumeTiming();
+    for (int64_t i{}; i < consumers * ElementsPerConsumer; ++i) {
+      queue.push(42);
+    }
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<double>(popped.load()), benchmark::Counter::kIsRate);
+}
+
+template <typename Queue>
+void BM_Consumers_AsyncPopOnPool(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  Queue queue{};
+  const auto consumers{state.range(0)};
+  FreshThreadPool pool{4};
+  auto onPool{[&pool](std::coroutine_handle<> coroutine) {
+    pool.submit([coroutine] { coroutine.resume(); });
+  }};
+  std::atomic<int64_t> popped{};
+  int64_t expected{};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int64_t i{}; i < consumers; ++i) {
+      asyncConsume(queue, popped, onPool);
+    }
+    expected += consumers * ElementsPerConsumer;
+    state.ResumeTiming();
+    for (int64_t i{}; i < consumers * ElementsPerConsumer; ++i) {
+      queue.push(42);
+    }
+    pool.runUntil(
+        [&] { return popped.load(std::memory_order_acquire) == expected; });
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<double>(popped.load()), benchmark::Counter::kIsRate);
+}
+
+void ConsumerSweep(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgName("Consumers")
+      ->RangeMultiplier(4)
+      ->Range(16, 4096)
+      ->MeasureProcessCPUTime()
+      ->UseRealTime();
+}
+
+BENCHMARK(BM_Consumers_WaitAndPop<ConcurrentFreshQueue<int>>)
+    ->Apply(ConsumerSweep);
+BENCHMARK(BM_Consumers_AsyncPopInline<ConcurrentFreshQueue<int>>)
+    ->Apply(ConsumerSweep);
+BENCHMARK(BM_Consumers_AsyncPopOnPool<ConcurrentFreshQueue<int>>)
+    ->Apply(ConsumerSweep);
+BENCHMARK(BM_Consumers_WaitAndPop<ThreadSafeFreshQueue<int>>)
+    ->Apply(ConsumerSweep);
+BENCHMARK(BM_Consumers_AsyncPopInline<ThreadSafeFreshQueue<int>>)
+    ->Apply(ConsumerSweep);
+BENCHMARK(BM_Consumers_AsyncPopOnPool<ThreadSafeFreshQueue<int>>)
+    ->Apply(ConsumerSweep);
+
+// Two processes exchanging 64-byte messages through a forked child, over
+// SharedMemoryFreshQueue rings or a Unix socketpair. Throughput sends batches
+// that the child acknowledges once each, so the time includes the child
+// keeping up; RoundTrip has the child echo every message, so the time per
+// iteration is the round-trip latency.
+struct ProcessMessage {
+  int64_t sequence{};
+  std::array<std::byte, 56> payload{};
 };
-BENCHMARK_TEMPLATE_DEFINE_F(BM_LockFreeFreshQueueMultiThreadFixture, PushAndPop,
-                            int)
-(benchmark::State &state) {
-  bool isPushingThread{state.thread_index() % 2 == 0};
-  if (isPushingThread) {
+
+class SocketPairLink {
+public:
+  SocketPairLink() {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, m_sockets) != 0)
+      throw std::system_error{errno, std::system_category(), "socketpair"};
+  }
+  SocketPairLink(const SocketPairLink &) = delete;
+  SocketPairLink &operator=(const SocketPairLink &) = delete;
+  ~SocketPairLink() {
+    close(m_sockets[0]);
+    close(m_sockets[1]);
+  }
+
+  void attachChild() {}
+  void toChild(const ProcessMessage &message) { send(m_sockets[0], message); }
+  void fromChild(ProcessMessage &message) { receive(m_sockets[0], message); }
+  void childSend(const ProcessMessage &message) { send(m_sockets[1], message); }
+  void childReceive(ProcessMessage &message) {
+    receive(m_sockets[1], message);
+  }
+
+private:
+  static void send(int socket, const ProcessMessage &message) {
+    auto bytes{reinterpret_cast<const char *>(&message)};
+    for (std::size_t sent{}; sent < sizeof(message);) {
+      auto count{write(socket, bytes + sent, sizeof(message) - sent)};
+      if (count <= 0)
+        throw std::system_error{errno, std::system_category(), "write"};
+      sent += static_cast<std::size_t>(count);
+    }
+  }
+
+  static void receive(int socket, ProcessMessage &message) {
+    auto bytes{reinterpret_cast<char *>(&message)};
+    for (std::size_t received{}; received < sizeof(message);) {
+      auto count{read(socket, bytes + received, sizeof(message) - received)};
+      if (count <= 0)
+        throw std::system_error{errno, std::system_category(), "read"};
+      received += static_cast<std::size_t>(count);
+    }
+  }
+
+  int m_sockets[2]{};
+};
+
+// The parent creates both rings; the child attaches to them by name.
+class SharedMemoryLink {
+  using Queue = SharedMemoryFreshQueue<ProcessMessage, 1024>;
+
+public:
+  SharedMemoryLink()
+      : m_down{Queue::create(queueName("down"))},
+        m_up{Queue::create(queueName("up"))} {}
+
+  void attachChild() {
+    m_childDown.reset(new Queue(Queue::attach(m_down.name())));
+    m_childUp.reset(new Queue(Queue::attach(m_up.name())));
+  }
+  void toChild(const ProcessMessage &message) { m_down.push(message); }
+  void fromChild(ProcessMessage &message) { m_up.waitAndPop(message); }
+  void childSend(const ProcessMessage &message) { m_childUp->push(message); }
+  void childReceive(ProcessMessage &message) {
+    m_childDown->waitAndPop(message);
+  }
+
+private:
+  static std::string queueName(const char *direction) {
+    return "/freshqueue-bench-" + std::to_string(getpid()) + "-" + direction;
+  }
+
+  Queue m_down;
+  Queue m_up;
+  std::unique_ptr<Queue> m_childDown;
+  std::unique_ptr<Queue> m_childUp;
+};
+
+// Runs in the forked child: replies to every ackEvery-th message and leaves
+// on a negative sequence number.
+template <typename Link>
+[[noreturn]] void serveChild(Link &link, int64_t ackEvery) {
+  link.attachChild();
+  ProcessMessage message{};
+  for (int64_t received{1};; ++received) {
+    link.childReceive(message);
+    if (message.sequence < 0)
+      break;
+    if (received % ackEvery == 0)
+      link.childSend(message);
+  }
+  _exit(0);
+}
+
+template <typename Link>
+void runWithChild(benchmark::State &state, int64_t batch) {
+  const PerfCounterScope perf{state};
+  Link link{};
+  auto child{fork()};
+  if (child < 0) {
+    state.SkipWithError("fork failed");
+    return;
+  }
+  if (child == 0)
+    serveChild(link, batch);
+  ProcessMessage message{};
+  for (auto _ : state) {
+    for (int64_t i{}; i < batch; ++i) {
+      ++message.sequence;
+      link.toChild(message);
+    }
+    link.fromChild(message);
+  }
+  message.sequence = -1;
+  link.toChild(message);
+  waitpid(child, nullptr, 0);
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * batch),
+                         benchmark::Counter::kIsRate);
+}
+
+template <typename Link>
+void BM_Process_Throughput(benchmark::State &state) {
+  runWithChild<Link>(state, 256);
+}
+
+template <typename Link> void BM_Process_RoundTrip(benchmark::State &state) {
+  runWithChild<Link>(state, 1);
+}
+
+BENCHMARK(BM_Process_Throughput<SharedMemoryLink>)->UseRealTime();
+BENCHMARK(BM_Process_Throughput<SocketPairLink>)->UseRealTime();
+BENCHMARK(BM_Process_RoundTrip<SharedMemoryLink>)->UseRealTime();
+BENCHMARK(BM_Process_RoundTrip<SocketPairLink>)->UseRealTime();
+
+// One producer fanning every event out to Consumers threads, either through a
+// single BroadcastFreshQueue whose cursors all read the same slot or by
+// pushing a copy into a bounded ThreadSafeFreshQueue per consumer. With
+// Chained set, each broadcast cursor runs strictly after the previous one.
+// Events are counted once however many consumers see them.
+class BroadcastFanOut {
+  using Queue = BroadcastFreshQueue<int64_t, 1024>;
+
+public:
+  BroadcastFanOut(std::size_t consumers, bool chained) {
+    for (std::size_t i{}; i < consumers; ++i) {
+      m_cursors.push_back(chained && i != 0
+                              ? &m_queue.subscribe({m_cursors.back()})
+                              : &m_queue.subscribe());
+    }
+  }
+
+  void publish(int64_t event) { m_queue.push(event); }
+
+  int64_t receive(std::size_t consumer) {
+    int64_t event{};
+    m_cursors[consumer]->waitAndPop(event);
+    return event;
+  }
+
+private:
+  Queue m_queue{};
+  std::vector<Queue::Cursor *> m_cursors{};
+};
+
+class SeparateQueuesFanOut {
+  using Queue = ThreadSafeFreshQueue<int64_t>;
+
+public:
+  SeparateQueuesFanOut(std::size_t consumers, bool) {
+    for (std::size_t i{}; i < consumers; ++i) {
+      m_queues.push_back(std::make_unique<Queue>(1024));
+    }
+  }
+
+  void publish(int64_t event) {
+    for (auto &queue : m_queues) {
+      queue->push(event);
+    }
+  }
+
+  int64_t receive(std::size_t consumer) {
+    int64_t event{};
+    m_queues[consumer]->waitAndPop(event);
+    return event;
+  }
+
+private:
+  std::vector<std::unique_ptr<Queue>> m_queues{};
+};
+
+template <typename FanOut>
+void BM_FanOut_PublishAndConsume(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  const auto consumers{static_cast<std::size_t>(state.range(0))};
+  FanOut fanOut{consumers, state.range(1) != 0};
+  std::vector<std::thread> threads{};
+  for (std::size_t i{}; i < consumers; ++i) {
+    threads.emplace_back([&, i] {
+      while (fanOut.receive(i) >= 0) {
+      }
+    });
+  }
+  int64_t event{};
+  for (auto _ : state) {
+    fanOut.publish(event++);
+  }
+  fanOut.publish(-1);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  state.counters["Pushes"] =
+      benchmark::Counter(static_cast<double>(state.iterations()),
+                         benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_FanOut_PublishAndConsume<BroadcastFanOut>)
+    ->ArgNames({"Consumers", "Chained"})
+    ->ArgsProduct({{3, 5}, {0, 1}})
+    ->UseRealTime();
+BENCHMARK(BM_FanOut_PublishAndConsume<SeparateQueuesFanOut>)
+    ->ArgNames({"Consumers", "Chained"})
+    ->ArgsProduct({{3, 5}, {0}})
+    ->UseRealTime();
+
+// A four-stage pipeline over PipelineItems integers: a serial source, two
+// parallel stages of Workers threads that each mix every value Work times,
+// and a serial sink that needs the values in source order. FreshPipeline
+// starts its threads on every run; TBB runs the same filters in an arena of
+// as many threads.
+constexpr std::uint64_t PipelineItems{1 << 14};
+constexpr std::size_t PipelineTokens{64};
+
+std::uint64_t mixRounds(std::uint64_t value, int64_t rounds) {
+  for (int64_t i{}; i < rounds; ++i) {
+    value = value * 6364136223846793005u + 1442695040888963407u;
+    value ^= value >> 29;
+  }
+  return value;
+}
+
+struct FreshFourStages {
+  static std::uint64_t run(std::size_t workers, int64_t rounds) {
+    FreshPipeline<> pipeline{PipelineTokens};
+    auto items{pipeline.source(
+        [next = std::uint64_t{}]() mutable -> std::optional<std::uint64_t> {
+          if (next == PipelineItems)
+            return std::nullopt;
+          return next++;
+        })};
+    auto mix{
+        [rounds](std::uint64_t value) { return mixRounds(value, rounds); }};
+    auto mixed{pipeline.stage(pipeline.stage(items, workers, mix), workers,
+                              mix)};
+    std::uint64_t checksum{};
+    pipeline.sink(mixed, 1, [&](std::uint64_t value) {
+      checksum = checksum * 31 + value;
+    });
+    pipeline.run();
+    return checksum;
+  }
+};
+
+struct TbbFourStages {
+  static std::uint64_t run(std::size_t workers, int64_t rounds) {
+    tbb::task_arena arena{static_cast<int>(2 * workers + 2)};
+    std::uint64_t checksum{};
+    arena.execute([&] {
+      std::uint64_t next{};
+      auto mix{
+          [rounds](std::uint64_t value) { return mixRounds(value, rounds); }};
+      tbb::parallel_pipeline(
+          PipelineTokens,
+          tbb::make_filter<void, std::uint64_t>(
+              tbb::filter_mode::serial_in_order,
+              [&](tbb::flow_control &control) -> std::uint64_t {
+                if (next == PipelineItems)
+                  control.stop();
+                return next++;
+              }) &
+              tbb::make_filter<std::uint64_t, std::uint64_t>(
+                  tbb::filter_mode::parallel, mix) &
+              tbb::make_filter<std::uint64_t, std::uint64_t>(
+                  tbb::filter_mode::parallel, mix) &
+              tbb::make_filter<std::uint64_t, void>(
+                  tbb::filter_mode::serial_in_order,
+                  [&](std::uint64_t value) {
+                    checksum = checksum * 31 + value;
+                  }));
+    });
+    return checksum;
+  }
+};
+
+template <typename Pipeline>
+void BM_Pipeline_FourStages(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  const auto workers{static_cast<std::size_t>(state.range(0))};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Pipeline::run(workers, state.range(1)));
+  }
+  state.counters["Pushes"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * PipelineItems),
+      benchmark::Counter::kIsRate);
+}
+
+void PipelineSweep(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"Workers", "Work"})
+      ->ArgsProduct({{1, 2, 4}, {0, 256}})
+      ->UseRealTime();
+}
+
+BENCHMARK(BM_Pipeline_FourStages<FreshFourStages>)->Apply(PipelineSweep);
+BENCHMARK(BM_Pipeline_FourStages<TbbFourStages>)->Apply(PipelineSweep);
+
+// Runs every FreshQueue configuration with the threads it was declared for,
+// four on an end declared for many. As in BM_MultiThread_PushAndPop, each
+// iteration producers push one element per consumer and consumers pop one
+// per producer.
+constexpr int64_t declaredThreads(std::size_t count) {
+  return count == 1 ? 1 : 4;
+}
+
+template <std::size_t Producing, std::size_t Consuming, std::size_t Limit,
+          typename WaitPolicy>
+void BM_FreshQueue_DeclaredShape(benchmark::State &state) {
+  const PerfCounterScope perf{state};
+  using Queue = FreshQueue<int, Producers<Producing>, Consumers<Consuming>,
+                           Capacity<Limit>, Wait<WaitPolicy>>;
+  static Queue queue{};
+  const auto producers{declaredThreads(Producing)};
+  const auto consumers{declaredThreads(Consuming)};
+  if (state.thread_index() < producers) {
     for (auto _ : state) {
-      m_queue.push(42);
+      for (int64_t i{}; i < consumers; ++i) {
+        queue.push(42);
+      }
     }
     state.counters["Pushes"] = benchmark::Counter(
-        static_cast<int64_t>(state.iterations()), benchmark::Counter::kIsRate);
+        static_cast<double>(state.iterations() * consumers),
+        benchmark::Counter::kIsRate);
   } else {
     int value{};
     for (auto _ : state) {
-      while (!m_queue.pop(value))
-        ;
-      benchmark::DoNotOptimize(value);
+      for (int64_t i{}; i < producers; ++i) {
+        queue.waitAndPop(value);
+        benchmark::DoNotOptimize(value);
+      }
     }
   }
 }
-BENCHMARK_REGISTER_F(BM_LockFreeFreshQueueMultiThreadFixture, PushAndPop)
-    ->ThreadRange(2, 1 << 10)
-    ->MeasureProcessCPUTime()
-    ->UseRealTime();
+
+template <std::size_t Producing, std::size_t Consuming>
+void DeclaredThreads(benchmark::internal::Benchmark *benchmark) {
+  const auto threads{declaredThreads(Producing) + declaredThreads(Consuming)};
+  benchmark->Threads(static_cast<int>(threads))
+      ->MeasureProcessCPUTime()
+      ->UseRealTime();
+}
+
+constexpr auto Many{ManyThreads};
+constexpr auto Unbounded{UnboundedCapacity};
+
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, 1, Unbounded, CondVarWait>)
+    ->Apply(DeclaredThreads<1, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, Many, Unbounded, CondVarWait>)
+    ->Apply(DeclaredThreads<1, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, 1, Unbounded, CondVarWait>)
+    ->Apply(DeclaredThreads<Many, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, Many, Unbounded, CondVarWait>)
+    ->Apply(DeclaredThreads<Many, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, 1, 64, CondVarWait>)
+    ->Apply(DeclaredThreads<1, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, Many, 64, CondVarWait>)
+    ->Apply(DeclaredThreads<1, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, 1, 64, CondVarWait>)
+    ->Apply(DeclaredThreads<Many, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, Many, 64, CondVarWait>)
+    ->Apply(DeclaredThreads<Many, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, 1, Unbounded, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<1, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, Many, Unbounded, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<1, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, 1, Unbounded, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<Many, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, Many, Unbounded, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<Many, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, 1, 64, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<1, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, Many, 64, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<1, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, 1, 64, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<Many, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, Many, 64, SpinYieldWait<>>)
+    ->Apply(DeclaredThreads<Many, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, 1, Unbounded, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<1, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, Many, Unbounded, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<1, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, 1, Unbounded, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<Many, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, Many, Unbounded, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<Many, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, 1, 64, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<1, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<1, Many, 64, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<1, Many>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, 1, 64, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<Many, 1>);
+BENCHMARK(BM_FreshQueue_DeclaredShape<Many, Many, 64, SpinAtomicWait<>>)
+    ->Apply(DeclaredThreads<Many, Many>);
@@ -0,0 +1,135 @@
+#pragma once
+#include "benchmark/benchmark.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <linux/perf_event.h>
+#include <mutex>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Config for a PERF_TYPE_HW_CACHE event counting read misses in cache.
+constexpr std::uint64_t cacheReadMisses(std::uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Attaches Linux perf_event_open counters, and the context switches getrusage
+// reports, to a benchmark's counters as averages per iteration. A scope opened
+// at the top of a benchmark body counts until the body returns, including any
+// threads or processes it starts, which inherit the events. Every benchmark
+// thread counts itself and Google Benchmark sums the threads, so with several
+// threads the figures are per iteration of each thread. The getrusage switches
+// are process-wide and taken by the first thread only.
+//
+// Voluntary switches are the ones a thread made by blocking, such as a
+// waitAndPop sleeping on a condition variable, and so count futex waits.
+// Events the kernel refuses are left out of the report rather than shown as
+// zero: hardware events need a PMU, which virtual machines often lack, and a
+// strict perf_event_paranoid allows user-space counts only, so kernel counts
+// are tried first.
+class PerfCounterScope {
+public:
+  explicit PerfCounterScope(benchmark::State &state) : m_state{state} {
+    raiseFileLimit();
+    for (std::size_t i{}; i < Events.size(); ++i) {
+      m_files[i] = open(Events[i]);
+    }
+    if (state.thread_index() == 0)
+      getrusage(RUSAGE_SELF, &m_usage);
+  }
+  PerfCounterScope(const PerfCounterScope &) = delete;
+  PerfCounterScope(PerfCounterScope &&) noexcept = delete;
+  PerfCounterScope &operator=(const PerfCounterScope &) = delete;
+  PerfCounterScope &operator=(PerfCounterScope &&) noexcept = delete;
+  virtual ~PerfCounterScope() {
+    for (std::size_t i{}; i < Events.size(); ++i) {
+      if (m_files[i] < 0)
+        continue;
+      Reading reading{};
+      if (::read(m_files[i], &reading, sizeof(reading)) == sizeof(reading) &&
+          reading.running != 0)
+        report(Events[i].name, static_cast<double>(reading.value) *
+                                   static_cast<double>(reading.enabled) /
+                                   static_cast<double>(reading.running));
+      ::close(m_files[i]);
+    }
+    rusage usage{};
+    if (m_state.thread_index() == 0 && getrusage(RUSAGE_SELF, &usage) == 0) {
+      report("VoluntarySwitches",
+             static_cast<double>(usage.ru_nvcsw - m_usage.ru_nvcsw));
+      report("InvoluntarySwitches",
+             static_cast<double>(usage.ru_nivcsw - m_usage.ru_nivcsw));
+    }
+  }
+
+private:
+  struct Event {
+    const char *name;
+    std::uint32_t type;
+    std::uint64_t config;
+  };
+
+  // Layout read() fills in for the read_format below. Enabled and running
+  // times differ once the kernel multiplexes more events than there are
+  // hardware counters, and scale the count up to the whole scope.
+  struct Reading {
+    std::uint64_t value;
+    std::uint64_t enabled;
+    std::uint64_t running;
+  };
+
+  static constexpr std::array<Event, 6> Events{{
+      {"Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"L1DMisses", PERF_TYPE_HW_CACHE,
+       cacheReadMisses(PERF_COUNT_HW_CACHE_L1D)},
+      {"LLCMisses", PERF_TYPE_HW_CACHE,
+       cacheReadMisses(PERF_COUNT_HW_CACHE_LL)},
+      {"ContextSwitches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+      {"CpuMigrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+  }};
+
+  static int open(const Event &event) {
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = event.type;
+    attributes.config = event.config;
+    attributes.inherit = 1;
+    attributes.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    for (auto userOnly : {false, true}) {
+      attributes.exclude_kernel = userOnly;
+      attributes.exclude_hv = userOnly;
+      auto file{syscall(SYS_perf_event_open, &attributes, 0, -1, -1,
+                        PERF_FLAG_FD_CLOEXEC)};
+      if (file >= 0)
+        return static_cast<int>(file);
+    }
+    return -1;
+  }
+
+  // Each thread of the widest sweeps holds one descriptor per event.
+  static void raiseFileLimit() {
+    static std::once_flag raised{};
+    std::call_once(raised, [] {
+      rlimit limit{};
+      if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+          limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+      }
+    });
+  }
+
+  void report(const char *name, double count) {
+    m_state.counters[name] =
+        benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+  }
+
+  benchmark::State &m_state;
+  std::array<int, Events.size()> m_files{};
+  rusage m_usage{};
+};
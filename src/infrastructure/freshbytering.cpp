@@ -0,0 +1,101 @@
+#include "include/infrastructure/freshbytering.h"
+
+#include <bit>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+static_assert(sizeof(std::atomic<std::uint32_t>) + sizeof(std::uint32_t) ==
+                  FreshByteRing::HeaderSize,
+              "record headers must stay eight bytes");
+
+FreshByteRing::FreshByteRing(std::size_t capacity)
+    : m_capacity{capacity}, m_mask{capacity - 1} {
+  if (capacity < 64 || !std::has_single_bit(capacity))
+    throw std::invalid_argument{
+        "capacity must be a power of two of at least 64 bytes"};
+  m_data = std::make_unique<std::byte[]>(capacity);
+}
+
+FreshByteRing::Header &FreshByteRing::header(std::size_t offset) noexcept {
+  return *std::launder(reinterpret_cast<Header *>(m_data.get() + offset));
+}
+
+void FreshByteRing::writeHeader(std::size_t offset, State state,
+                                std::size_t size) noexcept {
+  auto header{::new (m_data.get() + offset) Header{}};
+  header->state.store(state, std::memory_order_relaxed);
+  header->size = static_cast<std::uint32_t>(size);
+}
+
+std::optional<std::span<std::byte>> FreshByteRing::tryClaim(std::size_t size) {
+  if (size > maxRecordSize())
+    throw std::invalid_argument{"record does not fit in the ring"};
+  const auto total{recordSize(size)};
+  const std::lock_guard lock{m_claimMutex};
+  auto write{m_write.load(std::memory_order_relaxed)};
+  auto offset{write & m_mask};
+  const auto padding{offset + total > m_capacity ? m_capacity - offset : 0};
+  if (write + padding + total - m_cachedRead > m_capacity) {
+    m_cachedRead = m_read.load(std::memory_order_acquire);
+    if (write + padding + total - m_cachedRead > m_capacity)
+      return std::nullopt;
+  }
+  if (padding != 0) {
+    writeHeader(offset, State::Padding, padding - HeaderSize);
+    write += padding;
+    offset = 0;
+  }
+  writeHeader(offset, State::Claimed, size);
+  m_write.store(write + total, std::memory_order_release);
+  return std::span{m_data.get() + offset + HeaderSize, size};
+}
+
+std::span<std::byte> FreshByteRing::claim(std::size_t size) {
+  for (;;) {
+    if (auto record{tryClaim(size)})
+      return *record;
+    std::this_thread::yield();
+  }
+}
+
+void FreshByteRing::commit(std::span<std::byte> record) noexcept {
+  auto offset{static_cast<std::size_t>(record.data() - m_data.get())};
+  header(offset - HeaderSize)
+      .state.store(State::Committed, std::memory_order_release);
+}
+
+std::optional<std::span<const std::byte>> FreshByteRing::tryRead() noexcept {
+  for (;;) {
+    auto read{m_read.load(std::memory_order_relaxed)};
+    if (read == m_cachedWrite) {
+      m_cachedWrite = m_write.load(std::memory_order_acquire);
+      if (read == m_cachedWrite)
+        return std::nullopt;
+    }
+    const auto offset{read & m_mask};
+    auto &record{header(offset)};
+    const auto state{record.state.load(std::memory_order_acquire)};
+    if (state == State::Claimed)
+      return std::nullopt;
+    if (state == State::Padding) {
+      m_read.store(read + recordSize(record.size), std::memory_order_release);
+      continue;
+    }
+    m_releaseTo = read + recordSize(record.size);
+    return std::span<const std::byte>{m_data.get() + offset + HeaderSize,
+                                      record.size};
+  }
+}
+
+std::span<const std::byte> FreshByteRing::read() {
+  for (;;) {
+    if (auto record{tryRead()})
+      return *record;
+    std::this_thread::yield();
+  }
+}
+
+void FreshByteRing::release() noexcept {
+  m_read.store(m_releaseTo, std::memory_order_release);
+}
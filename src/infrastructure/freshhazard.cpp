@@ -0,0 +1,85 @@
+#include "include/infrastructure/freshhazard.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+FreshHazardDomain::~FreshHazardDomain() {
+  auto record{m_records.load(std::memory_order_acquire)};
+  while (record) {
+    for (auto &retired : record->retired) {
+      retired.deleter(retired.pointer);
+    }
+    delete std::exchange(record, record->next);
+  }
+}
+
+std::size_t FreshHazardDomain::retiredCount() const noexcept {
+  std::size_t count{};
+  for (auto record{m_records.load(std::memory_order_acquire)}; record;
+       record = record->next) {
+    count += record->retired.size();
+  }
+  return count;
+}
+
+// Reuses an idle record if there is one, so a domain ends up with as many
+// records as it ever had concurrent guards.
+FreshHazardDomain::Record *FreshHazardDomain::acquire() {
+  for (auto record{m_records.load(std::memory_order_acquire)}; record;
+       record = record->next) {
+    auto active{false};
+    if (!record->active.load(std::memory_order_relaxed) &&
+        record->active.compare_exchange_strong(active, true,
+                                               std::memory_order_acquire))
+      return record;
+  }
+  auto record{new Record{}};
+  auto head{m_records.load(std::memory_order_relaxed)};
+  do {
+    record->next = head;
+  } while (!m_records.compare_exchange_weak(head, record,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  m_recordCount.fetch_add(1, std::memory_order_relaxed);
+  return record;
+}
+
+void FreshHazardDomain::release(Record &record) noexcept {
+  for (auto &hazard : record.hazards) {
+    hazard.store(nullptr, std::memory_order_release);
+  }
+  record.active.store(false, std::memory_order_release);
+}
+
+// Twice as many retired nodes as there are slots means at least half of them
+// are freed by each scan, which keeps the amortised cost per node constant.
+void FreshHazardDomain::retire(Record &record, Retired retired) {
+  record.retired.push_back(retired);
+  const auto hazards{m_recordCount.load(std::memory_order_relaxed) *
+                     SlotsPerGuard};
+  if (record.retired.size() >= std::max<std::size_t>(2 * hazards, 64))
+    scan(record);
+}
+
+void FreshHazardDomain::scan(Record &record) {
+  std::vector<const void *> hazards{};
+  for (auto other{m_records.load(std::memory_order_acquire)}; other;
+       other = other->next) {
+    for (auto &hazard : other->hazards) {
+      if (auto pointer{hazard.load()})
+        hazards.push_back(pointer);
+    }
+  }
+  std::sort(hazards.begin(), hazards.end(), std::less<>{});
+  auto kept{std::partition(record.retired.begin(), record.retired.end(),
+                           [&](const Retired &retired) {
+                             return std::binary_search(
+                                 hazards.begin(), hazards.end(),
+                                 retired.pointer, std::less<>{});
+                           })};
+  for (auto it{kept}; it != record.retired.end(); ++it) {
+    it->deleter(it->pointer);
+  }
+  record.retired.erase(kept, record.retired.end());
+}
@@ -0,0 +1,84 @@
+#include "include/infrastructure/freshnodepool.h"
+
+FreshNodePool::FreshNodePool(std::pmr::memory_resource *upstream)
+    : m_upstream{upstream} {}
+
+FreshNodePool::~FreshNodePool() {
+  for (auto chunk : m_chunks) {
+    m_upstream->deallocate(chunk, ChunkSize, Granularity);
+  }
+}
+
+void *FreshNodePool::do_allocate(std::size_t bytes, std::size_t alignment) {
+  if (!isPooled(bytes, alignment))
+    return m_upstream->allocate(bytes, alignment);
+  auto index{classIndex(bytes)};
+  if (auto block{pop(m_sizeClasses[index])})
+    return block;
+  return refill(index);
+}
+
+void FreshNodePool::do_deallocate(void *pointer, std::size_t bytes,
+                                  std::size_t alignment) {
+  if (!isPooled(bytes, alignment)) {
+    m_upstream->deallocate(pointer, bytes, alignment);
+    return;
+  }
+  auto block{std::construct_at(static_cast<Block *>(pointer))};
+  push(m_sizeClasses[classIndex(bytes)], block, block);
+}
+
+FreshNodePool::Block *FreshNodePool::pop(SizeClass &sizeClass) noexcept {
+  auto current{sizeClass.freeList.load(std::memory_order_acquire)};
+  while (current.top) {
+    FreeList next{current.top->next.load(std::memory_order_relaxed),
+                  current.tag + 1};
+    if (sizeClass.freeList.compare_exchange_weak(current, next,
+                                                 std::memory_order_acquire))
+      return current.top;
+  }
+  return nullptr;
+}
+
+void FreshNodePool::push(SizeClass &sizeClass, Block *first,
+                         Block *last) noexcept {
+  auto current{sizeClass.freeList.load(std::memory_order_relaxed)};
+  FreeList next{first, 0};
+  do {
+    last->next.store(current.top, std::memory_order_relaxed);
+    next.tag = current.tag + 1;
+  } while (!sizeClass.freeList.compare_exchange_weak(
+      current, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// Carves a fresh chunk into blocks of the requested class, keeps the first one
+// for the caller and publishes the rest as a single chain.
+FreshNodePool::Block *FreshNodePool::refill(std::size_t index) {
+  const std::lock_guard chunkLock{m_chunkMutex};
+  if (auto block{pop(m_sizeClasses[index])})
+    return block;
+
+  const auto blockSize{(index + 1) * Granularity};
+  const auto blockCount{ChunkSize / blockSize};
+  m_chunks.reserve(m_chunks.size() + 1);
+  auto chunk{static_cast<std::byte *>(
+      m_upstream->allocate(ChunkSize, Granularity))};
+  m_chunks.push_back(chunk);
+
+  auto blockAt{[&](std::size_t i) {
+    return std::construct_at(
+        static_cast<Block *>(static_cast<void *>(chunk + i * blockSize)));
+  }};
+  auto first{blockAt(0)};
+  if (blockCount > 1) {
+    auto second{blockAt(1)};
+    auto last{second};
+    for (std::size_t i{2}; i < blockCount; ++i) {
+      auto block{blockAt(i)};
+      last->next.store(block, std::memory_order_relaxed);
+      last = block;
+    }
+    push(m_sizeClasses[index], second, last);
+  }
+  return first;
+}
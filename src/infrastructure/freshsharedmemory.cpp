@@ -0,0 +1,97 @@
+#include "include/infrastructure/freshsharedmemory.h"
+
+#include <cerrno>
+#include <climits>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+[[noreturn]] void throwErrno(const char *what) {
+  throw std::system_error{errno, std::system_category(), what};
+}
+
+void *map(int descriptor, std::size_t size) {
+  auto data{mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 descriptor, 0)};
+  if (data == MAP_FAILED)
+    throwErrno("mmap");
+  return data;
+}
+} // namespace
+
+FreshSharedMemory FreshSharedMemory::create(const std::string &name,
+                                            std::size_t size) {
+  auto descriptor{shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600)};
+  if (descriptor < 0)
+    throwErrno("shm_open");
+  void *data{};
+  try {
+    if (ftruncate(descriptor, static_cast<off_t>(size)) != 0)
+      throwErrno("ftruncate");
+    data = map(descriptor, size);
+  } catch (...) {
+    close(descriptor);
+    shm_unlink(name.c_str());
+    throw;
+  }
+  close(descriptor);
+  return FreshSharedMemory{name, data, size, true};
+}
+
+FreshSharedMemory FreshSharedMemory::attach(const std::string &name) {
+  auto descriptor{shm_open(name.c_str(), O_RDWR, 0)};
+  if (descriptor < 0)
+    throwErrno("shm_open");
+  void *data{};
+  struct stat status {};
+  try {
+    if (fstat(descriptor, &status) != 0)
+      throwErrno("fstat");
+    data = map(descriptor, static_cast<std::size_t>(status.st_size));
+  } catch (...) {
+    close(descriptor);
+    throw;
+  }
+  close(descriptor);
+  return FreshSharedMemory{name, data, static_cast<std::size_t>(status.st_size),
+                           false};
+}
+
+FreshSharedMemory::~FreshSharedMemory() {
+  munmap(m_data, m_size);
+  if (m_owner)
+    shm_unlink(m_name.c_str());
+}
+
+// Without FUTEX_PRIVATE_FLAG the kernel keys waiters by the physical page, so
+// processes that map the word at different addresses still meet.
+void futexWait(std::atomic<std::uint32_t> &word,
+               std::uint32_t expected) noexcept {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT,
+          expected, nullptr, nullptr, 0);
+#else
+  word.wait(expected);
+#endif
+}
+
+void futexWake(std::atomic<std::uint32_t> &word, int count) noexcept {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE,
+          count, nullptr, nullptr, 0);
+#else
+  if (count == INT_MAX)
+    word.notify_all();
+  else
+    word.notify_one();
+#endif
+}
@@ -0,0 +1,53 @@
+#include "include/infrastructure/freshspillingqueue.h"
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+[[noreturn]] void throwErrno(const char *what) {
+  throw std::system_error{errno, std::system_category(), what};
+}
+} // namespace
+
+FreshSpillFile::FreshSpillFile(const std::filesystem::path &directory,
+                               std::size_t size)
+    : m_size{size} {
+  auto path{(directory / "freshqueue-spill-XXXXXX").string()};
+  m_descriptor = mkstemp(path.data());
+  if (m_descriptor < 0)
+    throwErrno("mkstemp");
+  unlink(path.c_str());
+  if (ftruncate(m_descriptor, static_cast<off_t>(size)) != 0) {
+    auto error{errno};
+    close(m_descriptor);
+    throw std::system_error{error, std::system_category(), "ftruncate"};
+  }
+}
+
+FreshSpillFile::~FreshSpillFile() {
+  unmap();
+  close(m_descriptor);
+}
+
+void *FreshSpillFile::map() {
+  if (!m_data) {
+    auto data{mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   m_descriptor, 0)};
+    if (data == MAP_FAILED)
+      throwErrno("mmap");
+    m_data = data;
+  }
+  return m_data;
+}
+
+void FreshSpillFile::unmap() noexcept {
+  if (m_data) {
+    munmap(m_data, m_size);
+    m_data = nullptr;
+  }
+}
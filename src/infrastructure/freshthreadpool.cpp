@@ -0,0 +1,105 @@
+#include "include/infrastructure/freshthreadpool.h"
+
+namespace {
+struct CurrentWorker {
+  const void *pool;
+  std::size_t index;
+};
+
+thread_local CurrentWorker currentWorker{};
+} // namespace
+
+FreshThreadPool::FreshThreadPool(std::size_t workerCount)
+    : m_workerCount{workerCount} {
+  if (workerCount == 0)
+    throw std::invalid_argument{"at least one worker is required"};
+  m_workers.reset(new Worker[workerCount]);
+  for (std::size_t i{}; i < workerCount; ++i) {
+    m_workers[i].thread = std::thread{[this, i] { work(i); }};
+  }
+}
+
+FreshThreadPool::~FreshThreadPool() {
+  m_stopping = true;
+  ++m_epoch;
+  Idle::wake(m_epoch, true);
+  for (std::size_t i{}; i < m_workerCount; ++i) {
+    m_workers[i].thread.join();
+  }
+}
+
+void FreshThreadPool::enqueue(Task *task) {
+  if (currentWorker.pool == this)
+    m_workers[currentWorker.index].deque.push(task);
+  else
+    m_injected.push(task);
+  // The deque publishes with a relaxed store, which could otherwise be
+  // reordered after this load.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_sleepers != 0)
+    wakeOne();
+}
+
+bool FreshThreadPool::runOne() {
+  auto task{findTask()};
+  if (!task)
+    return false;
+  execute(task);
+  return true;
+}
+
+// Own deque first, then the injection queue, then the other workers' deques
+// starting with the next one along.
+FreshThreadPool::Task *FreshThreadPool::findTask() {
+  const bool isWorker{currentWorker.pool == this};
+  const auto home{isWorker ? currentWorker.index : 0};
+  if (isWorker) {
+    if (auto task{m_workers[home].deque.pop()})
+      return *task;
+  }
+  Task *task{};
+  if (m_injected.tryPop(task))
+    return task;
+  for (std::size_t i{isWorker ? 1u : 0u}; i < m_workerCount; ++i) {
+    auto index{home + i};
+    if (index >= m_workerCount)
+      index -= m_workerCount;
+    if (auto stolen{m_workers[index].deque.steal()})
+      return *stolen;
+  }
+  return nullptr;
+}
+
+void FreshThreadPool::execute(Task *task) noexcept {
+  task->execute(task, &m_taskPool);
+}
+
+void FreshThreadPool::wakeOne() noexcept {
+  ++m_epoch;
+  Idle::wake(m_epoch, false);
+}
+
+// A worker registers as a sleeper and reads the epoch before its last look
+// for work, so a task enqueued after that look always changes the epoch. This
+// pairs with enqueue: the sleeper increments m_sleepers and then loads the
+// deque bottoms, while enqueue stores a bottom, fences and then loads
+// m_sleepers. Both sides are seq_cst, so at least one sees the other.
+void FreshThreadPool::work(std::size_t index) {
+  currentWorker = {this, index};
+  for (;;) {
+    if (runOne())
+      continue;
+    ++m_sleepers;
+    auto epoch{m_epoch.load()};
+    auto task{findTask()};
+    if (!task && m_stopping) {
+      --m_sleepers;
+      return;
+    }
+    if (!task)
+      Idle::idle(m_epoch, epoch);
+    --m_sleepers;
+    if (task)
+      execute(task);
+  }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+
+#include "freshqueue.h"
+
+// Ring of variable-length byte records for messages that would otherwise each
+// cost a vector and a queue node. Producers claim room for a record, write it
+// in place and commit it; the consumer reads records in claim order straight
+// from the ring and releases each one when done with it. Every record starts
+// with an eight-byte header holding its length and state, and its payload is
+// padded to the next eight bytes. A record that would straddle the end of the
+// ring is preceded by a padding record that the consumer skips, so payloads
+// are always contiguous.
+//
+// Claims from several producers are serialised by a mutex held only while the
+// header is written; commits and the single consumer take no lock. A record
+// claimed but not yet committed holds back the ones claimed after it.
+// claim and read yield until there is room or a record, like SpscFreshQueue.
+class FreshByteRing {
+public:
+  static constexpr std::size_t HeaderSize{8};
+
+  // Capacity is in bytes and must be a power of two of at least 64 bytes.
+  explicit FreshByteRing(std::size_t capacity);
+  FreshByteRing(const FreshByteRing &) = delete;
+  FreshByteRing(FreshByteRing &&) noexcept = delete;
+  FreshByteRing &operator=(const FreshByteRing &) = delete;
+  FreshByteRing &operator=(FreshByteRing &&) noexcept = delete;
+  virtual ~FreshByteRing() = default;
+
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+  // Larger claims throw std::invalid_argument: keeping a record, its header
+  // and padding to half the ring guarantees that an empty ring fits it
+  // wherever the write position is.
+  std::size_t maxRecordSize() const noexcept {
+    return m_capacity / 2 - HeaderSize;
+  }
+
+  [[nodiscard]] bool empty() const noexcept {
+    return m_read.load(std::memory_order_acquire) ==
+           m_write.load(std::memory_order_acquire);
+  }
+
+  std::optional<std::span<std::byte>> tryClaim(std::size_t size);
+  std::span<std::byte> claim(std::size_t size);
+
+  // Publishes a span returned by tryClaim or claim, unchanged.
+  void commit(std::span<std::byte> record) noexcept;
+
+  // Consumer side. The span stays valid, and read keeps returning it, until
+  // release is called.
+  std::optional<std::span<const std::byte>> tryRead() noexcept;
+  std::span<const std::byte> read();
+  void release() noexcept;
+
+private:
+  enum class State : std::uint32_t { Claimed, Committed, Padding };
+
+  struct Header {
+    std::atomic<State> state;
+    std::uint32_t size;
+  };
+
+  static std::size_t recordSize(std::size_t size) noexcept {
+    return HeaderSize + ((size + HeaderSize - 1) & ~(HeaderSize - 1));
+  }
+
+  Header &header(std::size_t offset) noexcept;
+  void writeHeader(std::size_t offset, State state, std::size_t size) noexcept;
+
+  std::size_t m_capacity;
+  std::size_t m_mask;
+  std::unique_ptr<std::byte[]> m_data;
+  std::mutex m_claimMutex;
+  alignas(CacheLineSize) std::atomic<std::size_t> m_write{0};
+  std::size_t m_cachedRead{0};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_read{0};
+  std::size_t m_cachedWrite{0};
+  std::size_t m_releaseTo{0};
+};
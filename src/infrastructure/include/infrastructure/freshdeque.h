@@ -0,0 +1,138 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "freshqueue.h"
+
+// Chase-Lev work-stealing deque. The owning thread pushes and pops at the
+// bottom without contention; other threads steal from the top and only race
+// with the owner for the last element. Elements are copied in and out of the
+// ring through relaxed atomics, so T must be trivially copyable: store a
+// pointer to anything larger. The ring doubles when full, and arrays it has
+// outgrown are kept until destruction because a thief may still be reading
+// them.
+template <typename T> class WorkStealingFreshDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are copied through relaxed atomics");
+
+private:
+  class Ring {
+  public:
+    explicit Ring(std::size_t capacity)
+        : m_mask{capacity - 1}, m_slots{new std::atomic<T>[capacity]} {}
+
+    std::size_t capacity() const noexcept { return m_mask + 1; }
+
+    T get(std::int64_t index) const noexcept {
+      return m_slots[static_cast<std::size_t>(index) & m_mask].load(
+          std::memory_order_relaxed);
+    }
+
+    void put(std::int64_t index, T value) noexcept {
+      m_slots[static_cast<std::size_t>(index) & m_mask].store(
+          value, std::memory_order_relaxed);
+    }
+
+  private:
+    std::size_t m_mask;
+    std::unique_ptr<std::atomic<T>[]> m_slots;
+  };
+
+public:
+  explicit WorkStealingFreshDeque(std::size_t capacity = 256) {
+    if (!std::has_single_bit(capacity))
+      throw std::invalid_argument{"capacity must be a power of two"};
+    m_rings.push_back(std::make_unique<Ring>(capacity));
+    m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+  }
+  WorkStealingFreshDeque(const WorkStealingFreshDeque &) = delete;
+  WorkStealingFreshDeque(WorkStealingFreshDeque &&) noexcept = delete;
+  WorkStealingFreshDeque &operator=(const WorkStealingFreshDeque &) = delete;
+  WorkStealingFreshDeque &
+  operator=(WorkStealingFreshDeque &&) noexcept = delete;
+  virtual ~WorkStealingFreshDeque() = default;
+
+  // Approximate when other threads are pushing or stealing.
+  std::size_t size() const noexcept {
+    auto bottom{m_bottom.load(std::memory_order_relaxed)};
+    auto top{m_top.load(std::memory_order_relaxed)};
+    return bottom > top ? static_cast<std::size_t>(bottom - top) : 0;
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+  // Owner only.
+  void push(T value) {
+    auto bottom{m_bottom.load(std::memory_order_relaxed)};
+    auto top{m_top.load(std::memory_order_acquire)};
+    auto ring{m_ring.load(std::memory_order_relaxed)};
+    if (bottom - top >= static_cast<std::int64_t>(ring->capacity()))
+      ring = grow(ring, top, bottom);
+    ring->put(bottom, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. Takes the most recently pushed element.
+  std::optional<T> pop() noexcept {
+    auto bottom{m_bottom.load(std::memory_order_relaxed) - 1};
+    auto ring{m_ring.load(std::memory_order_relaxed)};
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top{m_top.load(std::memory_order_relaxed)};
+    if (top > bottom) {
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return {};
+    }
+    auto value{ring->get(bottom)};
+    if (top == bottom) {
+      // Last element: whoever moves top first gets it.
+      auto won{m_top.compare_exchange_strong(top, top + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)};
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      if (!won)
+        return {};
+    }
+    return value;
+  }
+
+  // Any thread. Takes the oldest element, and also comes back empty when it
+  // loses a race for it.
+  std::optional<T> steal() noexcept {
+    auto top{m_top.load(std::memory_order_acquire)};
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto bottom{m_bottom.load(std::memory_order_acquire)};
+    if (top >= bottom)
+      return {};
+    auto value{m_ring.load(std::memory_order_acquire)->get(top)};
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+      return {};
+    return value;
+  }
+
+private:
+  Ring *grow(Ring *ring, std::int64_t top, std::int64_t bottom) {
+    auto bigger{std::make_unique<Ring>(ring->capacity() * 2)};
+    for (auto i{top}; i < bottom; ++i) {
+      bigger->put(i, ring->get(i));
+    }
+    m_rings.push_back(std::move(bigger));
+    ring = m_rings.back().get();
+    m_ring.store(ring, std::memory_order_release);
+    return ring;
+  }
+
+  alignas(CacheLineSize) std::atomic<std::int64_t> m_top{};
+  alignas(CacheLineSize) std::atomic<std::int64_t> m_bottom{};
+  std::atomic<Ring *> m_ring{};
+  std::vector<std::unique_ptr<Ring>> m_rings;
+};
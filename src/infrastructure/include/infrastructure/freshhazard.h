@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Hazard pointers (Michael, 2004) for lock-free structures whose unlinked
+// nodes other threads may still be reading. A thread announces a node it is
+// about to dereference in one of its Guard's slots; a node that has been
+// unlinked is retired rather than deleted, and retired nodes are only deleted
+// once no slot anywhere holds them. Since a protected node cannot be freed,
+// its address cannot be reused under a reader either, which rules out ABA on
+// compare-exchanges of protected pointers.
+//
+// Guards lease records that the domain keeps in a lock-free list and never
+// frees before it is destroyed, so the list only grows to the peak number of
+// concurrent guards. Each record carries its owner's retired nodes, which are
+// scanned against every slot once there are enough of them to make a scan pay
+// for itself. A structure owns its domain; destroying the domain deletes
+// whatever is still retired, so it must outlive every guard.
+class FreshHazardDomain {
+public:
+  static constexpr std::size_t SlotsPerGuard{2};
+
+  class Guard;
+
+  FreshHazardDomain() = default;
+  FreshHazardDomain(const FreshHazardDomain &) = delete;
+  FreshHazardDomain(FreshHazardDomain &&) noexcept = delete;
+  FreshHazardDomain &operator=(const FreshHazardDomain &) = delete;
+  FreshHazardDomain &operator=(FreshHazardDomain &&) noexcept = delete;
+  virtual ~FreshHazardDomain();
+
+  // Nodes retired but not yet deleted, for tests and diagnostics. Only exact
+  // while no guard is alive.
+  std::size_t retiredCount() const noexcept;
+
+private:
+  struct Retired {
+    void *pointer;
+    void (*deleter)(void *) noexcept;
+  };
+
+  struct alignas(64) Record {
+    std::array<std::atomic<const void *>, SlotsPerGuard> hazards{};
+    std::atomic<bool> active{true};
+    Record *next{};
+    std::vector<Retired> retired{};
+  };
+
+  Record *acquire();
+  void release(Record &record) noexcept;
+  void retire(Record &record, Retired retired);
+  void scan(Record &record);
+
+  std::atomic<Record *> m_records{};
+  std::atomic<std::size_t> m_recordCount{};
+};
+
+class FreshHazardDomain::Guard {
+public:
+  explicit Guard(FreshHazardDomain &domain)
+      : m_domain{domain}, m_record{domain.acquire()} {}
+  Guard(const Guard &) = delete;
+  Guard(Guard &&) noexcept = delete;
+  Guard &operator=(const Guard &) = delete;
+  Guard &operator=(Guard &&) noexcept = delete;
+  virtual ~Guard() { m_domain.release(*m_record); }
+
+  // Loads source and announces the result in slot, retrying until source
+  // still holds it afterwards: from then on it cannot be deleted until the
+  // slot is cleared or reused.
+  template <typename T>
+  T *protect(std::size_t slot, const std::atomic<T *> &source) noexcept {
+    auto &hazard{m_record->hazards[slot]};
+    auto pointer{source.load()};
+    for (;;) {
+      hazard.store(pointer);
+      auto current{source.load()};
+      if (current == pointer)
+        return pointer;
+      pointer = current;
+    }
+  }
+
+  void clear(std::size_t slot) noexcept {
+    m_record->hazards[slot].store(nullptr, std::memory_order_release);
+  }
+
+  // Hands over an unlinked node to be deleted once no slot holds it.
+  template <typename T> void retire(T *pointer) {
+    m_domain.retire(*m_record,
+                    Retired{pointer, [](void *retired) noexcept {
+                              delete static_cast<T *>(retired);
+                            }});
+  }
+
+private:
+  FreshHazardDomain &m_domain;
+  Record *m_record;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Memory resource for queue nodes and element control blocks. Small requests
+// are served from per-size-class free lists that any thread may push to or pop
+// from without locking, so a block released on a consumer thread is handed
+// straight back to the next producer and steady-state push/pop never reaches
+// the upstream resource. Chunks are only returned upstream on destruction.
+class FreshNodePool : public std::pmr::memory_resource {
+public:
+  static constexpr std::size_t Granularity{16};
+  static constexpr std::size_t MaxBlockSize{256};
+  static constexpr std::size_t ChunkSize{64 * 1024};
+
+  FreshNodePool() : FreshNodePool{std::pmr::get_default_resource()} {}
+  explicit FreshNodePool(std::pmr::memory_resource *upstream);
+  FreshNodePool(const FreshNodePool &) = delete;
+  FreshNodePool(FreshNodePool &&) noexcept = delete;
+  FreshNodePool &operator=(const FreshNodePool &) = delete;
+  FreshNodePool &operator=(FreshNodePool &&) noexcept = delete;
+  ~FreshNodePool() override;
+
+  std::pmr::memory_resource *upstream_resource() const noexcept {
+    return m_upstream;
+  }
+
+protected:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void *pointer, std::size_t bytes,
+                     std::size_t alignment) override;
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct Block {
+    std::atomic<Block *> next;
+  };
+
+  // The tag is bumped on every update so a pop that raced with a pop and a
+  // push of the same block fails its compare-exchange.
+  struct alignas(2 * sizeof(void *)) FreeList {
+    Block *top;
+    std::uintptr_t tag;
+  };
+
+  struct alignas(64) SizeClass {
+    std::atomic<FreeList> freeList{FreeList{nullptr, 0}};
+  };
+
+  static bool isPooled(std::size_t bytes, std::size_t alignment) noexcept {
+    return bytes <= MaxBlockSize && alignment <= Granularity;
+  }
+
+  static std::size_t classIndex(std::size_t bytes) noexcept {
+    return bytes == 0 ? 0 : (bytes - 1) / Granularity;
+  }
+
+  Block *pop(SizeClass &sizeClass) noexcept;
+  void push(SizeClass &sizeClass, Block *first, Block *last) noexcept;
+  Block *refill(std::size_t index);
+
+  std::pmr::memory_resource *m_upstream;
+  std::array<SizeClass, MaxBlockSize / Granularity> m_sizeClasses{};
+  std::mutex m_chunkMutex;
+  std::vector<void *> m_chunks;
+};
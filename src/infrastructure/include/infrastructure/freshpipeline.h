@@ -0,0 +1,506 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "freshqueue.h"
+
+// Processing graph of stages that each run on their own worker threads and
+// hand elements to the next stage through a FreshQueue. Sources generate
+// elements until their function returns std::nullopt, stages transform them
+// and sinks consume them. A stage with one worker is serial; with more it is
+// parallel and calls its function from all of them at once. Passing one stage
+// to several others copies every element to each of them (fan-out); a stage
+// given several inputs takes elements from all of them (fan-in).
+//
+// Every link is chosen from the topology when the pipeline runs: one with a
+// single producing and a single consuming thread is an SpscFreshQueue, any
+// other a LockFreeFreshQueue. A serial stage whose elements all come down one
+// path from one source sees them in the order the source produced them, even
+// behind parallel stages, as with TBB's serial_in_order filters.
+//
+// At most maxTokens elements are in flight at once: a source takes one token
+// per path its elements fan out into and every sink returns one, so memory
+// stays bounded however unbalanced the stages are. Since no link can then hold
+// more than maxTokens elements, links are rings of LinkCapacity slots and
+// pushes never wait. An exception thrown by a stage function stops the
+// sources, and run rethrows the first one once every worker has finished.
+//
+// Idle stages yield rather than sleep by default. A pipeline is kept busy,
+// and a stage blocked on a futex would cost its producer a wake-up system
+// call on every push until it runs again.
+template <std::size_t LinkCapacity = 1024, typename Idle = SpinYieldIdle<16>>
+class FreshPipeline {
+  struct Node;
+  template <typename T> struct Output;
+
+public:
+  // Handle to a source or stage, passed to the stages and sinks it feeds.
+  template <typename T> class Stage {
+  private:
+    friend class FreshPipeline;
+
+    Stage(FreshPipeline &pipeline, Node &node, Output<T> &output)
+        : m_pipeline{&pipeline}, m_node{&node}, m_output{&output} {}
+
+    FreshPipeline *m_pipeline;
+    Node *m_node;
+    Output<T> *m_output;
+  };
+
+  explicit FreshPipeline(std::size_t maxTokens)
+      : m_maxTokens{maxTokens}, m_tokens{maxTokens} {
+    if (maxTokens == 0 || maxTokens > LinkCapacity)
+      throw std::invalid_argument{
+          "tokens must be between one and the link capacity"};
+  }
+  FreshPipeline(const FreshPipeline &) = delete;
+  FreshPipeline(FreshPipeline &&) noexcept = delete;
+  FreshPipeline &operator=(const FreshPipeline &) = delete;
+  FreshPipeline &operator=(FreshPipeline &&) noexcept = delete;
+  virtual ~FreshPipeline() = default;
+
+  std::size_t maxTokens() const noexcept { return m_maxTokens; }
+
+  // Links feeding a stage or sink, and how many of them are single-producer
+  // single-consumer rings.
+  std::size_t linkCount() const noexcept {
+    return static_cast<std::size_t>(std::count_if(
+        m_nodes.begin(), m_nodes.end(),
+        [](const auto &node) { return !node->upstream.empty(); }));
+  }
+
+  std::size_t spscLinkCount() const noexcept {
+    return static_cast<std::size_t>(std::count_if(
+        m_nodes.begin(), m_nodes.end(),
+        [](const auto &node) { return spsc(*node); }));
+  }
+
+  // Generate returns std::optional<T> and is only ever called from one thread.
+  template <typename F> auto source(F &&generate) {
+    using T = typename std::invoke_result_t<std::decay_t<F> &>::value_type;
+    auto node{
+        add<SourceNode<T, std::decay_t<F>>>(1, std::forward<F>(generate))};
+    return Stage<T>{*this, *node, node->output};
+  }
+
+  template <typename T, typename F>
+  auto stage(Stage<T> input, std::size_t workerCount, F &&transform) {
+    return stage({input}, workerCount, std::forward<F>(transform));
+  }
+
+  template <typename T, typename F>
+  auto stage(std::initializer_list<Stage<T>> inputs, std::size_t workerCount,
+             F &&transform) {
+    using U = std::invoke_result_t<std::decay_t<F> &, T &&>;
+    check(inputs);
+    auto node{add<TransformNode<T, U, std::decay_t<F>>>(
+        workerCount, std::forward<F>(transform))};
+    connect(inputs, *node);
+    return Stage<U>{*this, *node, node->output};
+  }
+
+  template <typename T, typename F>
+  void sink(Stage<T> input, std::size_t workerCount, F &&consume) {
+    sink({input}, workerCount, std::forward<F>(consume));
+  }
+
+  template <typename T, typename F>
+  void sink(std::initializer_list<Stage<T>> inputs, std::size_t workerCount,
+            F &&consume) {
+    check(inputs);
+    auto node{add<SinkNode<T, std::decay_t<F>>>(workerCount,
+                                                std::forward<F>(consume))};
+    connect(inputs, *node);
+  }
+
+  // Starts every worker and returns once all sources are exhausted and every
+  // element has reached a sink. A pipeline runs once.
+  void run() {
+    if (m_started)
+      throw std::logic_error{"a pipeline runs once"};
+    for (auto &node : m_nodes) {
+      if (!node->sink && node->downstream.empty())
+        throw std::logic_error{"every stage needs a stage or sink to feed"};
+      if (node->upstream.empty() && sinkPaths(*node) > m_maxTokens)
+        throw std::invalid_argument{"a source fans out into more paths than "
+                                    "there are tokens"};
+    }
+    m_started = true;
+    for (auto &node : m_nodes) {
+      node->open(*this);
+    }
+    std::vector<std::thread> threads{};
+    for (auto &node : m_nodes) {
+      for (std::size_t i{}; i < node->workerCount; ++i) {
+        threads.emplace_back([this, &node] {
+          try {
+            node->work(*this);
+          } catch (...) {
+            fail(std::current_exception());
+          }
+          node->finish();
+        });
+      }
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    if (m_error)
+      std::rethrow_exception(m_error);
+  }
+
+private:
+  // The sequence number is the element's position in its source's output.
+  template <typename T> struct Token {
+    std::uint64_t sequence{};
+    T value{};
+  };
+
+  // Wakes waiters only when there are any. The fence orders the store that
+  // made progress before the waiter count is read, against a waiter
+  // registering before it rechecks.
+  struct WaitPoint {
+    void notify(bool all) noexcept {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters.load(std::memory_order_relaxed) != 0) {
+        ++epoch;
+        Idle::wake(epoch, all);
+      }
+    }
+
+    template <typename Ready> void wait(Ready ready) {
+      if (ready())
+        return;
+      ++waiters;
+      for (;;) {
+        auto seen{epoch.load()};
+        if (ready())
+          break;
+        Idle::idle(epoch, seen);
+      }
+      --waiters;
+    }
+
+    alignas(CacheLineSize) std::atomic<std::size_t> waiters{};
+    alignas(CacheLineSize) std::atomic<std::uint32_t> epoch{};
+  };
+
+  // Input of one stage. Each producing thread closes it once, and a pop fails
+  // only when all of them have and nothing is left.
+  template <typename T> class Link {
+  public:
+    void open(std::size_t producers, std::size_t consumers) {
+      m_producers.store(producers);
+      if (producers == 1 && consumers == 1)
+        m_spsc = std::make_unique<SpscFreshQueue<Token<T>, LinkCapacity>>();
+      else
+        m_mpmc = std::make_unique<LockFreeFreshQueue<Token<T>, LinkCapacity>>();
+    }
+
+    void push(Token<T> &&token) {
+      if (m_spsc)
+        m_spsc->push(std::move(token));
+      else
+        m_mpmc->push(std::move(token));
+      m_pushed.notify(false);
+    }
+
+    bool pop(Token<T> &token) {
+      auto popped{false};
+      m_pushed.wait([&] {
+        popped = tryPop(token);
+        return popped || m_producers.load() == 0;
+      });
+      return popped || tryPop(token);
+    }
+
+    void close() noexcept {
+      if (--m_producers == 0)
+        m_pushed.notify(true);
+    }
+
+  private:
+    bool tryPop(Token<T> &token) {
+      return m_spsc ? m_spsc->tryPop(token) : m_mpmc->tryPop(token);
+    }
+
+    std::unique_ptr<SpscFreshQueue<Token<T>, LinkCapacity>> m_spsc;
+    std::unique_ptr<LockFreeFreshQueue<Token<T>, LinkCapacity>> m_mpmc;
+    std::atomic<std::size_t> m_producers{};
+    WaitPoint m_pushed;
+  };
+
+  struct Node {
+    Node(std::size_t workers, bool terminal)
+        : workerCount{workers}, sink{terminal} {}
+    Node(const Node &) = delete;
+    Node(Node &&) noexcept = delete;
+    Node &operator=(const Node &) = delete;
+    Node &operator=(Node &&) noexcept = delete;
+    virtual ~Node() = default;
+
+    virtual void open(FreshPipeline &pipeline) = 0;
+    // Runs one worker until its input is exhausted or the pipeline fails.
+    virtual void work(FreshPipeline &pipeline) = 0;
+    // Called once by each worker after work, even if it threw.
+    virtual void finish() noexcept = 0;
+
+    std::size_t workerCount;
+    bool sink;
+    std::vector<Node *> upstream{};
+    std::vector<Node *> downstream{};
+  };
+
+  // Copies the element into every link but the last, which gets it moved.
+  template <typename T> struct Output {
+    void emit(std::uint64_t sequence, T &&value) {
+      if constexpr (std::is_copy_constructible_v<T>) {
+        for (std::size_t i{1}; i < links.size(); ++i) {
+          links[i]->push(Token<T>{sequence, value});
+        }
+      }
+      links.front()->push(Token<T>{sequence, std::move(value)});
+    }
+
+    void close() noexcept {
+      for (auto link : links) {
+        link->close();
+      }
+    }
+
+    std::vector<Link<T> *> links{};
+  };
+
+  template <typename T, typename F> struct SourceNode : Node {
+    SourceNode(std::size_t, F function)
+        : Node{1, false}, generate{std::move(function)} {}
+
+    void open(FreshPipeline &) override { weight = sinkPaths(*this); }
+
+    void work(FreshPipeline &pipeline) override {
+      for (std::uint64_t sequence{}; pipeline.acquire(weight); ++sequence) {
+        auto value{std::invoke(generate)};
+        if (!value) {
+          pipeline.release(weight);
+          break;
+        }
+        output.emit(sequence, std::move(*value));
+      }
+    }
+
+    void finish() noexcept override { output.close(); }
+
+    F generate;
+    std::size_t weight{};
+    Output<T> output{};
+  };
+
+  // A serial stage behind a parallel one holds back elements that overtook
+  // an earlier one. Their sequence numbers all lie within maxTokens of the
+  // one it waits for, since each of those elements holds a token, so a ring
+  // of maxTokens slots has room for them.
+  template <typename T> struct ConsumerNode : Node {
+    using Node::Node;
+
+    virtual void process(FreshPipeline &pipeline, Token<T> &&token) = 0;
+
+    void open(FreshPipeline &pipeline) override {
+      std::size_t producers{};
+      for (auto node : this->upstream) {
+        producers += node->workerCount;
+      }
+      input.open(producers, this->workerCount);
+      const auto lineage{FreshPipeline::lineage(*this)};
+      if (this->workerCount == 1 && lineage.paths == 1 && lineage.reordered)
+        pending.resize(pipeline.m_maxTokens);
+    }
+
+    void work(FreshPipeline &pipeline) override {
+      Token<T> token{};
+      while (!pipeline.m_failed.load(std::memory_order_relaxed) &&
+             input.pop(token)) {
+        if (pending.empty()) {
+          process(pipeline, std::move(token));
+          continue;
+        }
+        if (token.sequence != next) {
+          pending[token.sequence % pending.size()].emplace(std::move(token));
+          continue;
+        }
+        process(pipeline, std::move(token));
+        for (++next;; ++next) {
+          auto &slot{pending[next % pending.size()]};
+          if (!slot)
+            break;
+          process(pipeline, std::move(*slot));
+          slot.reset();
+        }
+      }
+    }
+
+    Link<T> input{};
+    std::vector<std::optional<Token<T>>> pending{};
+    std::uint64_t next{};
+  };
+
+  template <typename T, typename U, typename F>
+  struct TransformNode : ConsumerNode<T> {
+    TransformNode(std::size_t workers, F function)
+        : ConsumerNode<T>{workers, false}, transform{std::move(function)} {}
+
+    void process(FreshPipeline &, Token<T> &&token) override {
+      output.emit(token.sequence,
+                  std::invoke(transform, std::move(token.value)));
+    }
+
+    void finish() noexcept override { output.close(); }
+
+    F transform;
+    Output<U> output{};
+  };
+
+  template <typename T, typename F> struct SinkNode : ConsumerNode<T> {
+    SinkNode(std::size_t workers, F function)
+        : ConsumerNode<T>{workers, true}, consume{std::move(function)} {}
+
+    void process(FreshPipeline &pipeline, Token<T> &&token) override {
+      std::invoke(consume, std::move(token.value));
+      pipeline.release(1);
+    }
+
+    void finish() noexcept override {}
+
+    F consume;
+  };
+
+  // How many source-to-node paths reach a node, and whether a parallel stage
+  // on any of them may have reordered its elements.
+  struct Lineage {
+    std::size_t paths;
+    bool reordered;
+  };
+
+  static Lineage lineage(const Node &node) {
+    if (node.upstream.empty())
+      return {1, false};
+    Lineage result{0, false};
+    for (auto input : node.upstream) {
+      const auto inherited{lineage(*input)};
+      result.paths += inherited.paths;
+      result.reordered = result.reordered || inherited.reordered ||
+                         input->workerCount > 1;
+    }
+    return result;
+  }
+
+  // Every element a source produces ends up at this many sinks.
+  static std::size_t sinkPaths(const Node &node) {
+    if (node.sink)
+      return 1;
+    std::size_t paths{};
+    for (auto output : node.downstream) {
+      paths += sinkPaths(*output);
+    }
+    return paths;
+  }
+
+  static bool spsc(const Node &node) {
+    return !node.upstream.empty() && node.workerCount == 1 &&
+           node.upstream.size() == 1 && node.upstream.front()->workerCount == 1;
+  }
+
+  template <typename N, typename F> N *add(std::size_t workerCount, F &&f) {
+    if (m_started)
+      throw std::logic_error{"stages must be added before the pipeline runs"};
+    if (workerCount == 0)
+      throw std::invalid_argument{"a stage needs at least one worker"};
+    m_nodes.push_back(std::make_unique<N>(workerCount, std::forward<F>(f)));
+    return static_cast<N *>(m_nodes.back().get());
+  }
+
+  // Runs before the consuming node is added, so a rejected stage leaves the
+  // graph as it was.
+  template <typename T> void check(std::initializer_list<Stage<T>> inputs) {
+    static_assert(std::is_nothrow_move_constructible_v<T> &&
+                      std::is_default_constructible_v<T>,
+                  "links are rings of preallocated, nothrow movable slots");
+    if (inputs.size() == 0)
+      throw std::invalid_argument{"a stage needs at least one input"};
+    for (auto input{inputs.begin()}; input != inputs.end(); ++input) {
+      if (input->m_pipeline != this)
+        throw std::invalid_argument{"input belongs to another pipeline"};
+      if (std::any_of(inputs.begin(), input, [&](const Stage<T> &other) {
+            return other.m_node == input->m_node;
+          }))
+        throw std::invalid_argument{"a stage takes each input once"};
+      if (!std::is_copy_constructible_v<T> &&
+          !input->m_node->downstream.empty())
+        throw std::invalid_argument{"only copyable elements can fan out"};
+    }
+  }
+
+  template <typename T>
+  void connect(std::initializer_list<Stage<T>> inputs, ConsumerNode<T> &node) {
+    for (const auto &input : inputs) {
+      node.upstream.push_back(input.m_node);
+      input.m_node->downstream.push_back(&node);
+      input.m_output->links.push_back(&node.input);
+    }
+  }
+
+  // Returns false instead once the pipeline has failed.
+  bool acquire(std::size_t count) {
+    auto acquired{false};
+    m_released.wait([&] {
+      if (m_failed.load())
+        return true;
+      auto available{m_tokens.load()};
+      while (available >= count) {
+        if (m_tokens.compare_exchange_weak(available, available - count))
+          return acquired = true;
+      }
+      return false;
+    });
+    return acquired;
+  }
+
+  // Sources are only woken once half the tokens are back, so that they
+  // produce a batch per wakeup instead of one element per returned token.
+  // Every token comes back as the pipeline drains, so the mark is reached.
+  void release(std::size_t count) noexcept {
+    if (m_tokens.fetch_add(count) + count >= (m_maxTokens + 1) / 2)
+      m_released.notify(true);
+  }
+
+  void fail(std::exception_ptr error) noexcept {
+    {
+      const std::lock_guard lock{m_errorMutex};
+      if (!m_error)
+        m_error = std::move(error);
+    }
+    m_failed.store(true);
+    m_released.notify(true);
+  }
+
+  std::size_t m_maxTokens;
+  std::vector<std::unique_ptr<Node>> m_nodes{};
+  bool m_started{false};
+  std::mutex m_errorMutex;
+  std::exception_ptr m_error{};
+  std::atomic<bool> m_failed{false};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_tokens;
+  WaitPoint m_released;
+};
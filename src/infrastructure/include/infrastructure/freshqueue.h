@@ -1,9 +1,35 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
 #include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
 #include <queue>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "freshhazard.h"
+
+inline constexpr std::size_t CacheLineSize{64};
+inline constexpr std::size_t UnboundedCapacity{
+    std::numeric_limits<std::size_t>::max()};
 
 class EmptyQueue : std::exception {
   virtual const char *what() const noexcept override {
@@ -11,9 +37,395 @@ class EmptyQueue : std::exception {
   };
 };
 
-template <typename T> class ThreadSafeFreshQueue {
+// Wait policies decide how waitAndPop blocks while the queue is empty, and how
+// waitAndPush blocks while a bounded queue is full. The queue calls wait()
+// holding the lock that guards the end being waited on, and calls
+// notifyOne()/notifyAll() only when hasWaiters() reports a registered waiter,
+// so an uncontended push or pop never makes a wake-up call. RequiresWaitLock
+// asks the queue to pass through that lock before notifying when the caller
+// did not hold it, which closes the window between a waiter's last check and
+// its sleep.
+
+inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+class CondVarWait {
+public:
+  static constexpr bool RequiresWaitLock{true};
+
+  [[nodiscard]] bool hasWaiters() const noexcept { return m_waiters != 0; }
+
+  template <typename Ready>
+  void wait(std::unique_lock<std::mutex> &lock, Ready ready) {
+    if (ready())
+      return;
+    ++m_waiters;
+    m_condition.wait(lock, ready);
+    --m_waiters;
+  }
+
+  void notifyOne() noexcept { m_condition.notify_one(); }
+
+  void notifyAll() noexcept { m_condition.notify_all(); }
+
+private:
+  std::atomic<std::size_t> m_waiters{};
+  std::condition_variable m_condition;
+};
+
+// Base for the policies that wait without a condition variable. Waiters drop
+// the lock and watch an epoch counter that producers bump when a waiter is
+// registered; the epoch is read before the emptiness check, so a push that
+// lands after the check always changes it.
+template <typename Idle> class EpochWait {
+public:
+  static constexpr bool RequiresWaitLock{false};
+
+  [[nodiscard]] bool hasWaiters() const noexcept { return m_waiters != 0; }
+
+  template <typename Ready>
+  void wait(std::unique_lock<std::mutex> &lock, Ready ready) {
+    if (ready())
+      return;
+    ++m_waiters;
+    for (;;) {
+      auto epoch{m_epoch.load()};
+      if (ready())
+        break;
+      lock.unlock();
+      Idle::idle(m_epoch, epoch);
+      lock.lock();
+    }
+    --m_waiters;
+  }
+
+  void notifyOne() noexcept {
+    ++m_epoch;
+    Idle::wake(m_epoch, false);
+  }
+
+  void notifyAll() noexcept {
+    ++m_epoch;
+    Idle::wake(m_epoch, true);
+  }
+
+private:
+  std::atomic<std::size_t> m_waiters{};
+  alignas(CacheLineSize) std::atomic<std::uint32_t> m_epoch{};
+};
+
+struct BusySpinIdle {
+  static void idle(const std::atomic<std::uint32_t> &epoch,
+                   std::uint32_t seen) noexcept {
+    while (epoch.load(std::memory_order_relaxed) == seen) {
+      cpuRelax();
+    }
+  }
+
+  static void wake(std::atomic<std::uint32_t> &, bool) noexcept {}
+};
+
+template <std::size_t Spins> struct SpinYieldIdle {
+  static void idle(const std::atomic<std::uint32_t> &epoch,
+                   std::uint32_t seen) noexcept {
+    for (std::size_t i{}; i < Spins; ++i) {
+      if (epoch.load(std::memory_order_relaxed) != seen)
+        return;
+      cpuRelax();
+    }
+    while (epoch.load(std::memory_order_relaxed) == seen) {
+      std::this_thread::yield();
+    }
+  }
+
+  static void wake(std::atomic<std::uint32_t> &, bool) noexcept {}
+};
+
+template <std::size_t Spins> struct SpinAtomicIdle {
+  static void idle(const std::atomic<std::uint32_t> &epoch,
+                   std::uint32_t seen) noexcept {
+    for (std::size_t i{}; i < Spins; ++i) {
+      if (epoch.load(std::memory_order_relaxed) != seen)
+        return;
+      cpuRelax();
+    }
+    epoch.wait(seen);
+  }
+
+  static void wake(std::atomic<std::uint32_t> &epoch, bool all) noexcept {
+    if (all)
+      epoch.notify_all();
+    else
+      epoch.notify_one();
+  }
+};
+
+using BusySpinWait = EpochWait<BusySpinIdle>;
+template <std::size_t Spins = 128>
+using SpinYieldWait = EpochWait<SpinYieldIdle<Spins>>;
+template <std::size_t Spins = 128>
+using SpinAtomicWait = EpochWait<SpinAtomicIdle<Spins>>;
+
+// Storage policies for ThreadSafeFreshQueue. InlineStorage keeps elements by
+// value in the queue's deque, so the value overloads never allocate and the
+// shared_ptr overloads allocate only when they are called. SharedStorage keeps
+// every element behind a shared_ptr, which makes the pointer overloads free at
+// the cost of an allocation per push.
+template <typename T> struct InlineStorage {
+  using Element = T;
+
+  template <typename Container, typename... Args>
+  static void emplace(Container &container, Args &&...args) {
+    container.emplace(std::forward<Args>(args)...);
+  }
+
+  static T &get(Element &element) noexcept { return element; }
+
+  static std::shared_ptr<T> share(Element &element) {
+    return std::make_shared<T>(std::move(element));
+  }
+};
+
+template <typename T> struct SharedStorage {
+  using Element = std::shared_ptr<T>;
+
+  template <typename Container, typename... Args>
+  static void emplace(Container &container, Args &&...args) {
+    container.emplace(std::make_shared<T>(std::forward<Args>(args)...));
+  }
+
+  static T &get(Element &element) noexcept { return *element; }
+
+  static std::shared_ptr<T> share(Element &element) noexcept {
+    return element;
+  }
+};
+
+// Snapshot returned by ConcurrentFreshQueue::stats(). Counters are read one at
+// a time while the queue keeps running, so they need not add up exactly.
+struct FreshQueueStats {
+  std::size_t depth{};
+  std::size_t highWaterDepth{};
+  std::uint64_t pushes{};
+  std::uint64_t pops{};
+  std::uint64_t failedLocks{};
+  std::uint64_t waits{};
+  std::chrono::nanoseconds totalWait{};
+  std::chrono::nanoseconds maxWait{};
+};
+
+// Stats policies for ConcurrentFreshQueue. NoStats leaves every hook empty, so
+// the default queue carries no counters and pays nothing for them.
+struct NoStats {
+  static constexpr bool Enabled{false};
+
+  void pushed(std::size_t) noexcept {}
+  void popped(std::size_t) noexcept {}
+  void failedLock() noexcept {}
+  void waited(std::chrono::nanoseconds) noexcept {}
+};
+
+// Counts into one of a fixed set of cache-line-sized stripes picked by thread,
+// with relaxed atomics, so threads counting at the same time rarely share a
+// line. Depth has to be a single figure to give a high-water mark, so it is
+// one shared counter that the queue updates under its tail and head locks.
+class QueueStats {
+public:
+  static constexpr bool Enabled{true};
+
+  void pushed(std::size_t count) noexcept {
+    stripe().pushes.fetch_add(count, std::memory_order_relaxed);
+    auto depth{m_depth.fetch_add(count, std::memory_order_relaxed) + count};
+    raise(m_highWaterDepth, depth);
+  }
+
+  void popped(std::size_t count) noexcept {
+    stripe().pops.fetch_add(count, std::memory_order_relaxed);
+    m_depth.fetch_sub(count, std::memory_order_relaxed);
+  }
+
+  void failedLock() noexcept {
+    stripe().failedLocks.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void waited(std::chrono::nanoseconds duration) noexcept {
+    auto &counters{stripe()};
+    auto nanoseconds{static_cast<std::uint64_t>(duration.count())};
+    counters.waits.fetch_add(1, std::memory_order_relaxed);
+    counters.waitNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    raise(counters.maxWaitNanoseconds, nanoseconds);
+  }
+
+  FreshQueueStats snapshot() const noexcept {
+    FreshQueueStats stats{};
+    stats.depth = m_depth.load(std::memory_order_relaxed);
+    stats.highWaterDepth = m_highWaterDepth.load(std::memory_order_relaxed);
+    std::uint64_t maxWait{};
+    for (auto &counters : m_stripes) {
+      stats.pushes += counters.pushes.load(std::memory_order_relaxed);
+      stats.pops += counters.pops.load(std::memory_order_relaxed);
+      stats.failedLocks += counters.failedLocks.load(std::memory_order_relaxed);
+      stats.waits += counters.waits.load(std::memory_order_relaxed);
+      stats.totalWait += std::chrono::nanoseconds{
+          counters.waitNanoseconds.load(std::memory_order_relaxed)};
+      maxWait = std::max(
+          maxWait, counters.maxWaitNanoseconds.load(std::memory_order_relaxed));
+    }
+    stats.maxWait = std::chrono::nanoseconds{maxWait};
+    return stats;
+  }
+
+private:
+  static constexpr std::size_t StripeCount{16};
+
+  struct alignas(CacheLineSize) Stripe {
+    std::atomic<std::uint64_t> pushes{};
+    std::atomic<std::uint64_t> pops{};
+    std::atomic<std::uint64_t> failedLocks{};
+    std::atomic<std::uint64_t> waits{};
+    std::atomic<std::uint64_t> waitNanoseconds{};
+    std::atomic<std::uint64_t> maxWaitNanoseconds{};
+  };
+
+  Stripe &stripe() noexcept {
+    static std::atomic<std::size_t> nextThread{};
+    thread_local const std::size_t thread{nextThread++};
+    return m_stripes[thread % StripeCount];
+  }
+
+  // The maximum is read first, so values below it never write the line.
+  template <typename U>
+  static void raise(std::atomic<U> &maximum, U value) noexcept {
+    auto current{maximum.load(std::memory_order_relaxed)};
+    while (current < value &&
+           !maximum.compare_exchange_weak(current, value,
+                                          std::memory_order_relaxed))
+      ;
+  }
+
+  std::array<Stripe, StripeCount> m_stripes{};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_depth{};
+  std::atomic<std::size_t> m_highWaterDepth{};
+};
+
+// Runs a coroutine resumed by asyncPop on the thread whose push resumed it.
+struct InlineExecutor {
+  void operator()(std::coroutine_handle<> handle) const { handle.resume(); }
+};
+
+// Coroutines suspended in asyncPop, kept in arrival order under a mutex that
+// pushes only take while the atomic count says someone is waiting. A waiter
+// registers and retries the pop under that mutex, and a push checks the count
+// only after its element is in the queue, so one of the two always sees the
+// other. A push pops the element for the oldest waiter itself and hands the
+// waiter to its executor outside the lock.
+template <typename T> class AsyncPopWaiters {
+public:
+  struct Waiter {
+    std::optional<T> value{};
+    Waiter *next{};
+    void (*dispatch)(Waiter &) noexcept {};
+  };
+
+  // Returns false when tryPop found an element instead, which is then in
+  // waiter.value.
+  template <typename TryPop> bool suspend(Waiter &waiter, TryPop &tryPop) {
+    const std::lock_guard lock{m_mutex};
+    ++m_count;
+    if (tryPop(waiter.value)) {
+      --m_count;
+      return false;
+    }
+    (m_tail ? m_tail->next : m_head) = &waiter;
+    m_tail = &waiter;
+    return true;
+  }
+
+  // Called after count elements were added to the queue.
+  template <typename TryPop> void resume(std::size_t count, TryPop tryPop) {
+    for (; count != 0 && m_count != 0; --count) {
+      Waiter *waiter{};
+      {
+        const std::lock_guard lock{m_mutex};
+        if (!m_head || !tryPop(m_head->value))
+          return;
+        waiter = std::exchange(m_head, m_head->next);
+        if (!m_head)
+          m_tail = nullptr;
+        --m_count;
+      }
+      waiter->dispatch(*waiter);
+    }
+  }
+
+private:
+  std::mutex m_mutex;
+  Waiter *m_head{};
+  Waiter *m_tail{};
+  std::atomic<std::size_t> m_count{};
+};
+
+// Awaitable returned by asyncPop. It pops without suspending when the queue
+// has an element; otherwise the push that provides one passes the coroutine to
+// Executor, which must eventually resume it. Executors should not throw.
+template <typename T, typename TryPop, typename Executor>
+class AsyncPop : private AsyncPopWaiters<T>::Waiter {
+  using Waiter = typename AsyncPopWaiters<T>::Waiter;
+
+public:
+  AsyncPop(AsyncPopWaiters<T> &waiters, TryPop tryPop, Executor executor)
+      : m_waiters{waiters}, m_tryPop{std::move(tryPop)},
+        m_executor{std::move(executor)} {}
+
+  bool await_ready() { return m_tryPop(this->value); }
+
+  bool await_suspend(std::coroutine_handle<> coroutine) {
+    m_coroutine = coroutine;
+    this->dispatch = &AsyncPop::dispatchTo;
+    return m_waiters.suspend(*this, m_tryPop);
+  }
+
+  T await_resume() { return std::move(*this->value); }
+
+private:
+  // The awaiter lives in the coroutine frame, which resuming may destroy, so
+  // the executor runs from a copy.
+  static void dispatchTo(Waiter &waiter) noexcept {
+    auto &self{static_cast<AsyncPop &>(waiter)};
+    auto executor{std::move(self.m_executor)};
+    executor(self.m_coroutine);
+  }
+
+  AsyncPopWaiters<T> &m_waiters;
+  TryPop m_tryPop;
+  Executor m_executor;
+  std::coroutine_handle<> m_coroutine{};
+};
+
+// A queue constructed with a capacity never holds more than that many
+// elements: tryPush fails and push/waitAndPush block while it is full. Blocked
+// producers are released together once consumers drain the queue down to the
+// low watermark, so under overload they take turns in batches instead of
+// waking on every pop.
+template <typename T, template <typename> typename Storage = InlineStorage,
+          typename WaitPolicy = CondVarWait>
+class ThreadSafeFreshQueue {
+  using StoragePolicy = Storage<T>;
+
 public:
   ThreadSafeFreshQueue() = default;
+  explicit ThreadSafeFreshQueue(std::size_t capacity)
+      : ThreadSafeFreshQueue{capacity, capacity / 2} {}
+  ThreadSafeFreshQueue(std::size_t capacity, std::size_t lowWatermark)
+      : m_capacity{capacity}, m_lowWatermark{lowWatermark} {
+    if (capacity == 0 || lowWatermark >= capacity)
+      throw std::invalid_argument{"low watermark must be below capacity"};
+  }
   ThreadSafeFreshQueue(const ThreadSafeFreshQueue &) = delete;
   ThreadSafeFreshQueue(ThreadSafeFreshQueue &&) noexcept = delete;
   ThreadSafeFreshQueue &operator=(const ThreadSafeFreshQueue &) = delete;
@@ -30,26 +442,75 @@ public:
     return m_queue.empty();
   }
 
-  void push(T val) {
-    const std::lock_guard lock{m_mutex};
-    m_queue.push(std::make_shared<T>(std::move(val)));
-    m_pushNotification.notify_one();
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+  std::size_t lowWatermark() const noexcept { return m_lowWatermark; }
+
+  void push(const T &value) { emplace(value); }
+
+  void push(T &&value) { emplace(std::move(value)); }
+
+  void waitAndPush(const T &value) { emplace(value); }
+
+  void waitAndPush(T &&value) { emplace(std::move(value)); }
+
+  // Constructs the element in the queue from args, waiting for room first.
+  template <typename... Args> void emplace(Args &&...args) {
+    std::unique_lock uniqueLock{m_mutex};
+    m_notFull.wait(uniqueLock, [&] { return hasRoom(); });
+    StoragePolicy::emplace(m_queue, std::forward<Args>(args)...);
+    if (m_notEmpty.hasWaiters())
+      m_notEmpty.notifyOne();
+    uniqueLock.unlock();
+    resumeAsyncPops(1);
+  }
+
+  bool tryPush(const T &value) { return tryPushValue(value); }
+
+  bool tryPush(T &&value) { return tryPushValue(std::move(value)); }
+
+  // A bounded queue takes as much of the range as fits, wakes consumers for
+  // what it took and waits for room before continuing.
+  template <std::input_iterator InputIt>
+  void pushRange(InputIt first, InputIt last) {
+    std::size_t count{};
+    std::unique_lock uniqueLock{m_mutex};
+    for (; first != last; ++first, ++count) {
+      if (!hasRoom()) {
+        notifyPushes(count);
+        uniqueLock.unlock();
+        resumeAsyncPops(count);
+        count = 0;
+        uniqueLock.lock();
+        m_notFull.wait(uniqueLock, [&] { return hasRoom(); });
+      }
+      StoragePolicy::emplace(m_queue, *first);
+    }
+    uniqueLock.unlock();
+    notifyPushes(count);
+    resumeAsyncPops(count);
+  }
+
+  void push(std::span<const T> values) {
+    pushRange(values.begin(), values.end());
   }
 
   void pop(T &value) {
     const std::lock_guard lock{m_mutex};
     if (m_queue.empty())
       throw EmptyQueue{};
-    value = std::move(*m_queue.front());
+    value = std::move(StoragePolicy::get(m_queue.front()));
     m_queue.pop();
+    releaseProducers();
   }
 
   std::shared_ptr<T> pop() {
     const std::lock_guard lock{m_mutex};
     if (m_queue.empty())
       throw EmptyQueue{};
-    auto result{m_queue.front()};
+    auto result{StoragePolicy::share(m_queue.front())};
     m_queue.pop();
+    releaseProducers();
     return result;
   }
 
@@ -57,8 +518,9 @@ public:
     const std::lock_guard lock{m_mutex};
     if (m_queue.empty())
       return false;
-    value = std::move(*m_queue.front());
+    value = std::move(StoragePolicy::get(m_queue.front()));
     m_queue.pop();
+    releaseProducers();
     return true;
   }
 
@@ -66,62 +528,232 @@ public:
     const std::lock_guard lock{m_mutex};
     if (m_queue.empty())
       return {};
-    auto result{m_queue.front()};
+    auto result{StoragePolicy::share(m_queue.front())};
     m_queue.pop();
+    releaseProducers();
     return result;
   }
 
   void waitAndPop(T &value) {
     std::unique_lock uniqueLock{m_mutex};
-    m_pushNotification.wait(uniqueLock, [&] { return !m_queue.empty(); });
-    value = std::move(*m_queue.front());
+    m_notEmpty.wait(uniqueLock, [&] { return !m_queue.empty(); });
+    value = std::move(StoragePolicy::get(m_queue.front()));
     m_queue.pop();
-    return;
+    releaseProducers();
   }
 
   std::shared_ptr<T> waitAndPop() {
     std::unique_lock uniqueLock{m_mutex};
-    m_pushNotification.wait(uniqueLock, [&] { return !m_queue.empty(); });
-    auto result{m_queue.front()};
+    m_notEmpty.wait(uniqueLock, [&] { return !m_queue.empty(); });
+    auto result{StoragePolicy::share(m_queue.front())};
     m_queue.pop();
+    releaseProducers();
     return result;
   }
 
+  template <typename OutputIt>
+  std::size_t tryPopBulk(OutputIt destination, std::size_t maxCount) {
+    const std::lock_guard lock{m_mutex};
+    return popBulk(destination, maxCount);
+  }
+
+  template <typename OutputIt>
+  std::size_t waitAndPopBulk(OutputIt destination, std::size_t maxCount) {
+    std::unique_lock uniqueLock{m_mutex};
+    m_notEmpty.wait(uniqueLock, [&] { return !m_queue.empty(); });
+    return popBulk(destination, maxCount);
+  }
+
+  // co_await queue.asyncPop() yields the next element, suspending the
+  // coroutine rather than blocking its thread while the queue is empty. The
+  // queue must outlive every coroutine suspended on it.
+  template <typename Executor = InlineExecutor>
+  auto asyncPop(Executor executor = {}) {
+    return AsyncPop{
+        m_asyncPops,
+        [this](std::optional<T> &value) { return tryPopInto(value); },
+        std::move(executor)};
+  }
+
 private:
-  std::queue<std::shared_ptr<T>> m_queue;
+  bool hasRoom() const noexcept { return m_queue.size() < m_capacity; }
+
+  bool tryPopInto(std::optional<T> &value) {
+    const std::lock_guard lock{m_mutex};
+    if (m_queue.empty())
+      return false;
+    value.emplace(std::move(StoragePolicy::get(m_queue.front())));
+    m_queue.pop();
+    releaseProducers();
+    return true;
+  }
+
+  void resumeAsyncPops(std::size_t count) {
+    m_asyncPops.resume(
+        count, [this](std::optional<T> &value) { return tryPopInto(value); });
+  }
+
+  template <typename U> bool tryPushValue(U &&value) {
+    {
+      const std::lock_guard lock{m_mutex};
+      if (!hasRoom())
+        return false;
+      StoragePolicy::emplace(m_queue, std::forward<U>(value));
+    }
+    notifyPushes(1);
+    resumeAsyncPops(1);
+    return true;
+  }
+
+  template <typename OutputIt>
+  std::size_t popBulk(OutputIt &destination, std::size_t maxCount) {
+    std::size_t count{};
+    for (; count < maxCount && !m_queue.empty(); ++count) {
+      *destination = std::move(StoragePolicy::get(m_queue.front()));
+      ++destination;
+      m_queue.pop();
+    }
+    releaseProducers();
+    return count;
+  }
+
+  void notifyPushes(std::size_t count) {
+    if (count == 0 || !m_notEmpty.hasWaiters())
+      return;
+    if (count == 1)
+      m_notEmpty.notifyOne();
+    else
+      m_notEmpty.notifyAll();
+  }
+
+  // Called with the lock held after every pop.
+  void releaseProducers() {
+    if (m_queue.size() <= m_lowWatermark && m_notFull.hasWaiters())
+      m_notFull.notifyAll();
+  }
+
+  std::queue<typename StoragePolicy::Element> m_queue;
   mutable std::mutex m_mutex;
-  std::condition_variable m_pushNotification;
+  std::size_t m_capacity{UnboundedCapacity};
+  std::size_t m_lowWatermark{};
+  WaitPolicy m_notEmpty;
+  WaitPolicy m_notFull;
+  AsyncPopWaiters<T> m_asyncPops;
 };
 
-template <typename T> class ConcurrentFreshQueue {
+// Nodes and element control blocks are obtained from Allocator. Pairing a
+// std::pmr::polymorphic_allocator with a FreshNodePool recycles both, so
+// steady-state push/pop does not call the global allocator. Capacity and low
+// watermark behave as in ThreadSafeFreshQueue; the element count they need is
+// only maintained when the queue is bounded. With a Stats policy such as
+// QueueStats, locks are tried before they are taken so that contention can be
+// counted, and stats() reports what the policy has collected.
+template <typename T, typename Allocator = std::allocator<T>,
+          typename WaitPolicy = CondVarWait, typename Stats = NoStats>
+class ConcurrentFreshQueue {
 private:
+  struct Node;
+  using NodeAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Node>;
+  using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+  // Refers back to the queue's allocator instead of holding a copy, since
+  // allocators such as polymorphic_allocator are not assignable.
+  struct NodeDeleter {
+    NodeAllocator *allocator{};
+
+    void operator()(Node *node) const noexcept {
+      NodeTraits::destroy(*allocator, node);
+      NodeTraits::deallocate(*allocator, node, 1);
+    }
+  };
+  using NodePtr = std::unique_ptr<Node, NodeDeleter>;
+
   struct Node {
     std::shared_ptr<T> data;
-    std::unique_ptr<Node> next;
+    NodePtr next;
   };
 
 public:
-  ConcurrentFreshQueue() : m_head{new Node{}}, m_tail{m_head.get()} {};
+  ConcurrentFreshQueue() : ConcurrentFreshQueue{Allocator{}} {};
+  explicit ConcurrentFreshQueue(const Allocator &allocator)
+      : m_allocator{allocator}, m_nodeAllocator{allocator},
+        m_head{makeNode()}, m_tail{m_head.get()} {};
+  explicit ConcurrentFreshQueue(std::size_t capacity,
+                                const Allocator &allocator = Allocator{})
+      : ConcurrentFreshQueue{capacity, capacity / 2, allocator} {};
+  ConcurrentFreshQueue(std::size_t capacity, std::size_t lowWatermark,
+                       const Allocator &allocator = Allocator{})
+      : m_allocator{allocator}, m_nodeAllocator{allocator},
+        m_head{makeNode()}, m_tail{m_head.get()}, m_capacity{capacity},
+        m_lowWatermark{lowWatermark} {
+    if (capacity == 0 || lowWatermark >= capacity)
+      throw std::invalid_argument{"low watermark must be below capacity"};
+  };
   ConcurrentFreshQueue(const ConcurrentFreshQueue &) = delete;
   ConcurrentFreshQueue(ConcurrentFreshQueue &&) noexcept = delete;
   ConcurrentFreshQueue &operator=(const ConcurrentFreshQueue &) = delete;
   ConcurrentFreshQueue &operator=(ConcurrentFreshQueue &&) noexcept = delete;
   virtual ~ConcurrentFreshQueue() = default;
 
+  Allocator get_allocator() const noexcept { return m_allocator; }
+
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+  std::size_t lowWatermark() const noexcept { return m_lowWatermark; }
+
+  FreshQueueStats stats() const noexcept
+    requires Stats::Enabled
+  {
+    return m_stats.snapshot();
+  }
+
 private:
+  bool bounded() const noexcept { return m_capacity != UnboundedCapacity; }
+
+  std::unique_lock<std::mutex> lock(std::mutex &mutex) {
+    if constexpr (Stats::Enabled) {
+      std::unique_lock guard{mutex, std::try_to_lock};
+      if (!guard.owns_lock()) {
+        m_stats.failedLock();
+        guard.lock();
+      }
+      return guard;
+    } else {
+      return std::unique_lock{mutex};
+    }
+  }
+
+  NodePtr makeNode() {
+    auto node{NodeTraits::allocate(m_nodeAllocator, 1)};
+    NodeTraits::construct(m_nodeAllocator, node);
+    return NodePtr{node, NodeDeleter{&m_nodeAllocator}};
+  }
+
+  template <typename... Args> std::shared_ptr<T> makeData(Args &&...args) {
+    return std::allocate_shared<T>(m_allocator, std::forward<Args>(args)...);
+  }
+
   Node *getTail() {
-    const std::lock_guard tailLock{m_tailMutex};
+    const auto tailLock{lock(m_tailMutex)};
     return m_tail;
   }
 
-  std::unique_ptr<Node> popHead() {
+  NodePtr unlinkHead() {
     auto head{std::move(m_head)};
     m_head = std::move(head->next);
     return head;
   }
 
-  std::unique_ptr<Node> tryPopHead() {
-    const std::lock_guard headLock{m_headMutex};
+  NodePtr popHead() {
+    auto head{unlinkHead()};
+    m_stats.popped(1);
+    releaseSlots(1);
+    return head;
+  }
+
+  NodePtr tryPopHead() {
+    const auto headLock{lock(m_headMutex)};
     if (m_head.get() == getTail()) {
       return {};
     }
@@ -129,7 +761,7 @@ private:
   }
 
   bool tryPopHead(T &value) {
-    const std::lock_guard headLock{m_headMutex};
+    const auto headLock{lock(m_headMutex)};
     if (m_head.get() == getTail()) {
       return false;
     }
@@ -138,35 +770,171 @@ private:
   }
 
   std::unique_lock<std::mutex> waitForData() {
-    std::unique_lock headLock{m_headMutex};
-    m_pushNotification.wait(headLock,
-                            [&] { return m_head.get() != getTail(); });
+    auto headLock{lock(m_headMutex)};
+    auto ready{[&] { return m_head.get() != getTail(); }};
+    if constexpr (Stats::Enabled) {
+      if (!ready()) {
+        const auto start{std::chrono::steady_clock::now()};
+        m_notEmpty.wait(headLock, ready);
+        m_stats.waited(std::chrono::steady_clock::now() - start);
+      }
+    } else {
+      m_notEmpty.wait(headLock, ready);
+    }
     return headLock;
   }
 
-  std::unique_ptr<Node> waitPopHead() {
+  NodePtr waitPopHead() {
     std::unique_lock headLock{waitForData()};
     return popHead();
   }
 
-  std::unique_ptr<Node> waitPopHead(T &value) {
+  NodePtr waitPopHead(T &value) {
     std::unique_lock headLock{waitForData()};
     value = std::move(*m_head->data);
     return popHead();
   }
 
-public:
-  void push(const T &value) {
-    auto newTail{std::make_unique<Node>()};
-    auto newTailRaw = newTail.get();
-    auto newData = std::make_shared<T>(std::move(value));
+  template <typename OutputIt>
+  std::size_t popHeads(OutputIt &destination, std::size_t maxCount) {
+    const Node *tail{getTail()};
+    std::size_t count{};
+    for (; count < maxCount && m_head.get() != tail; ++count) {
+      *destination = std::move(*m_head->data);
+      ++destination;
+      unlinkHead();
+    }
+    m_stats.popped(count);
+    releaseSlots(count);
+    return count;
+  }
+
+  // Links the chain [data, chainTail] in at the tail. A bounded queue first
+  // waits until it has room for all count elements, or gives up when Wait is
+  // false, in which case data is left with the caller.
+  template <bool Wait>
+  bool linkTail(std::shared_ptr<T> &&data, NodePtr chain, Node *chainTail,
+                std::size_t count) {
     {
-      std::lock_guard tailLock{m_tailMutex};
-      m_tail->data = newData;
-      m_tail->next = std::move(newTail);
-      m_tail = newTailRaw;
+      auto tailLock{lock(m_tailMutex)};
+      if (bounded()) {
+        auto hasRoom{[&] { return m_capacity - m_size >= count; }};
+        if constexpr (Wait)
+          m_notFull.wait(tailLock, hasRoom);
+        else if (!hasRoom())
+          return false;
+        m_size += count;
+      }
+      m_tail->data = std::move(data);
+      m_tail->next = std::move(chain);
+      m_tail = chainTail;
+      m_stats.pushed(count);
     }
-    m_pushNotification.notify_one();
+    notifyPushes(count);
+    resumeAsyncPops(count);
+    return true;
+  }
+
+  void notifyPushes(std::size_t count) {
+    if (count == 0 || !m_notEmpty.hasWaiters())
+      return;
+    if constexpr (WaitPolicy::RequiresWaitLock) {
+      const auto headLock{lock(m_headMutex)};
+    }
+    if (count == 1)
+      m_notEmpty.notifyOne();
+    else
+      m_notEmpty.notifyAll();
+  }
+
+  // Called with the head lock held; taking the tail lock under it follows the
+  // same order as getTail().
+  void releaseSlots(std::size_t count) {
+    if (!bounded() || count == 0)
+      return;
+    const auto size{m_size -= count};
+    if (size > m_lowWatermark || !m_notFull.hasWaiters())
+      return;
+    if constexpr (WaitPolicy::RequiresWaitLock) {
+      const auto tailLock{lock(m_tailMutex)};
+    }
+    m_notFull.notifyAll();
+  }
+
+  bool tryPopInto(std::optional<T> &value) {
+    auto head{tryPopHead()};
+    if (!head)
+      return false;
+    value.emplace(std::move(*head->data));
+    return true;
+  }
+
+  void resumeAsyncPops(std::size_t count) {
+    m_asyncPops.resume(
+        count, [this](std::optional<T> &value) { return tryPopInto(value); });
+  }
+
+public:
+  void push(const T &value) { emplace(value); }
+
+  void push(T &&value) { emplace(std::move(value)); }
+
+  void waitAndPush(const T &value) { emplace(value); }
+
+  void waitAndPush(T &&value) { emplace(std::move(value)); }
+
+  // Constructs the element from args, waiting for room first if bounded.
+  template <typename... Args> void emplace(Args &&...args) {
+    auto newTail{makeNode()};
+    auto newTailRaw{newTail.get()};
+    linkTail<true>(makeData(std::forward<Args>(args)...), std::move(newTail),
+                   newTailRaw, 1);
+  }
+
+  bool tryPush(const T &value) {
+    if (bounded() && m_size >= m_capacity)
+      return false;
+    auto newTail{makeNode()};
+    auto newTailRaw{newTail.get()};
+    return linkTail<false>(makeData(value), std::move(newTail), newTailRaw, 1);
+  }
+
+  // Leaves value as it was if the queue turns out to be full.
+  bool tryPush(T &&value) {
+    if (bounded() && m_size >= m_capacity)
+      return false;
+    auto newTail{makeNode()};
+    auto newTailRaw{newTail.get()};
+    auto data{makeData(std::move(value))};
+    if (linkTail<false>(std::move(data), std::move(newTail), newTailRaw, 1))
+      return true;
+    value = std::move(*data);
+    return false;
+  }
+
+  // The node chain is linked up before taking the tail lock, which is then
+  // held only long enough to splice it in. A bounded queue splices chains of
+  // at most capacity - lowWatermark nodes, which always fit once blocked
+  // producers are released.
+  template <std::input_iterator InputIt>
+  void pushRange(InputIt first, InputIt last) {
+    const auto maxChain{m_capacity - m_lowWatermark};
+    while (first != last) {
+      auto firstData{makeData(*first)};
+      auto chain{makeNode()};
+      auto chainTail{chain.get()};
+      std::size_t count{1};
+      for (++first; first != last && count < maxChain; ++first, ++count) {
+        chainTail->data = makeData(*first);
+        chainTail->next = makeNode();
+        chainTail = chainTail->next.get();
+      }
+      linkTail<true>(std::move(firstData), std::move(chain), chainTail, count);
+    }
+  }
+
+  void push(std::span<const T> values) {
+    pushRange(values.begin(), values.end());
   }
 
   std::shared_ptr<T> tryPop() {
@@ -183,15 +951,1492 @@ public:
 
   void waitAndPop(T &value) { waitPopHead(value); }
 
+  template <typename OutputIt>
+  std::size_t tryPopBulk(OutputIt destination, std::size_t maxCount) {
+    const auto headLock{lock(m_headMutex)};
+    return popHeads(destination, maxCount);
+  }
+
+  template <typename OutputIt>
+  std::size_t waitAndPopBulk(OutputIt destination, std::size_t maxCount) {
+    std::unique_lock headLock{waitForData()};
+    return popHeads(destination, maxCount);
+  }
+
   bool empty() {
-    const std::lock_guard headLock{m_headMutex};
+    const auto headLock{lock(m_headMutex)};
     return m_head.get() == getTail();
   }
 
+  // As ThreadSafeFreshQueue::asyncPop.
+  template <typename Executor = InlineExecutor>
+  auto asyncPop(Executor executor = {}) {
+    return AsyncPop{
+        m_asyncPops,
+        [this](std::optional<T> &value) { return tryPopInto(value); },
+        std::move(executor)};
+  }
+
 private:
-  std::unique_ptr<Node> m_head;
+  [[no_unique_address]] Allocator m_allocator;
+  [[no_unique_address]] NodeAllocator m_nodeAllocator;
+  NodePtr m_head;
   Node *m_tail;
   std::mutex m_headMutex;
   std::mutex m_tailMutex;
-  std::condition_variable m_pushNotification;
+  std::size_t m_capacity{UnboundedCapacity};
+  std::size_t m_lowWatermark{};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_size{};
+  WaitPolicy m_notEmpty;
+  WaitPolicy m_notFull;
+  [[no_unique_address]] Stats m_stats;
+  AsyncPopWaiters<T> m_asyncPops;
+};
+
+// Unbounded queue that stores elements inline in fixed-size segments instead
+// of behind one node and one shared_ptr each, after crossbeam's SegQueue.
+// Producers claim slots by advancing the tail index and consumers by advancing
+// the head index, one compare-exchange for a whole run of slots within a
+// segment, so bulk calls pay for their atomics once per run rather than once
+// per element. A state per slot, stored by its producer and then its consumer,
+// tells a consumer when its element is written and the queue when the slot is
+// done with. No lock is taken on either end: the producer that claims a
+// segment's last slot links the next one while the others wait for it, so
+// memory is allocated once per SegmentSize elements and consecutive pops read
+// adjacent slots. A segment the head has left is kept as a spare for producers
+// to reuse once every slot in it is read, so a queue that stays short does not
+// allocate at all. If moving an element out throws, it and the rest of the run
+// claimed with it are destroyed before the exception propagates. The mutex only
+// serves consumers about to wait.
+template <typename T, std::size_t SegmentSize = 64,
+          typename WaitPolicy = CondVarWait>
+class SegmentedFreshQueue {
+  static_assert(SegmentSize > 0, "segments need at least one slot");
+
+private:
+  // Producers mark their slot Written, or Skipped when the element's
+  // constructor threw, and consumers then add Read.
+  static constexpr std::uint8_t Written{1};
+  static constexpr std::uint8_t Skipped{2};
+  static constexpr std::uint8_t Read{4};
+
+  struct Slot {
+    T *element() noexcept {
+      return std::launder(reinterpret_cast<T *>(storage));
+    }
+
+    alignas(T) std::byte storage[sizeof(T)];
+    std::atomic<std::uint8_t> state{};
+  };
+
+  // next links the queue while the segment is live and the retired list once
+  // the head has left it.
+  struct Segment {
+    std::array<Slot, SegmentSize> slots;
+    std::atomic<Segment *> next{};
+  };
+
+  // Indices advance by Step per slot and by a lap of SegmentSize + 1 steps per
+  // segment, the extra step standing for the next segment being linked. Bit 0
+  // of the head index says the tail has left the head segment, which spares
+  // consumers from reading the tail.
+  static constexpr std::size_t HasNext{1};
+  static constexpr std::size_t Step{2};
+  static constexpr std::size_t Lap{SegmentSize + 1};
+
+  struct alignas(CacheLineSize) End {
+    std::atomic<std::size_t> index{};
+    std::atomic<Segment *> segment{};
+  };
+
+public:
+  SegmentedFreshQueue() {
+    auto segment{new Segment};
+    m_head.segment.store(segment, std::memory_order_relaxed);
+    m_tail.segment.store(segment, std::memory_order_relaxed);
+  }
+  SegmentedFreshQueue(const SegmentedFreshQueue &) = delete;
+  SegmentedFreshQueue(SegmentedFreshQueue &&) noexcept = delete;
+  SegmentedFreshQueue &operator=(const SegmentedFreshQueue &) = delete;
+  SegmentedFreshQueue &operator=(SegmentedFreshQueue &&) noexcept = delete;
+  virtual ~SegmentedFreshQueue() {
+    auto segment{m_head.segment.load(std::memory_order_relaxed)};
+    const auto tail{m_tail.index.load(std::memory_order_relaxed)};
+    for (auto head{m_head.index.load(std::memory_order_relaxed) & ~HasNext};
+         head != tail; head += Step) {
+      const auto offset{offsetOf(head)};
+      if (offset == SegmentSize) {
+        delete std::exchange(segment,
+                             segment->next.load(std::memory_order_relaxed));
+      } else if (auto &slot{segment->slots[offset]};
+                 slot.state.load(std::memory_order_relaxed) & Written) {
+        std::destroy_at(slot.element());
+      }
+    }
+    delete segment;
+    for (auto retired{m_retired.load(std::memory_order_relaxed)}; retired;) {
+      delete std::exchange(retired,
+                           retired->next.load(std::memory_order_relaxed));
+    }
+    delete m_spare.load(std::memory_order_relaxed);
+  }
+
+  static constexpr std::size_t segmentSize() noexcept { return SegmentSize; }
+
+  void push(const T &value) { emplace(value); }
+
+  void push(T &&value) { emplace(std::move(value)); }
+
+  // Constructs the element in its slot from args.
+  template <typename... Args> void emplace(Args &&...args) {
+    append(1, [&](std::byte *storage) {
+      std::construct_at(reinterpret_cast<T *>(storage),
+                        std::forward<Args>(args)...);
+    });
+    notifyPushes(1);
+  }
+
+  // Forward ranges are claimed a segment's worth of slots at a time; single
+  // pass ones one slot at a time, since their length is unknown up front.
+  template <std::input_iterator InputIt>
+  void pushRange(InputIt first, InputIt last) {
+    std::size_t count{};
+    auto make{[&](std::byte *storage) {
+      std::construct_at(reinterpret_cast<T *>(storage), *first);
+      ++first;
+      ++count;
+    }};
+    try {
+      if constexpr (std::forward_iterator<InputIt>) {
+        for (auto left{static_cast<std::size_t>(std::distance(first, last))};
+             left != 0;) {
+          left -= append(left, make);
+        }
+      } else {
+        while (first != last) {
+          append(1, make);
+        }
+      }
+    } catch (...) {
+      notifyPushes(count);
+      throw;
+    }
+    notifyPushes(count);
+  }
+
+  void push(std::span<const T> values) {
+    pushRange(values.begin(), values.end());
+  }
+
+  bool tryPop(T &value) {
+    auto destination{&value};
+    return popHeads(destination, 1) == 1;
+  }
+
+  void waitAndPop(T &value) {
+    auto pop{[&] { return tryPop(value); }};
+    if (pop())
+      return;
+    std::unique_lock waitLock{m_waitMutex};
+    m_notEmpty.wait(waitLock, pop);
+  }
+
+  template <typename OutputIt>
+  std::size_t tryPopBulk(OutputIt destination, std::size_t maxCount) {
+    return popHeads(destination, maxCount);
+  }
+
+  template <typename OutputIt>
+  std::size_t waitAndPopBulk(OutputIt destination, std::size_t maxCount) {
+    if (maxCount == 0)
+      return 0;
+    std::size_t count{};
+    auto pop{[&] { return (count = popHeads(destination, maxCount)) != 0; }};
+    if (!pop()) {
+      std::unique_lock waitLock{m_waitMutex};
+      m_notEmpty.wait(waitLock, pop);
+    }
+    return count;
+  }
+
+  [[nodiscard]] bool empty() const noexcept {
+    return m_head.index.load() / Step == m_tail.index.load() / Step;
+  }
+
+private:
+  static std::size_t offsetOf(std::size_t index) noexcept {
+    return index / Step % Lap;
+  }
+
+  static std::size_t lapOf(std::size_t index) noexcept {
+    return index / Step / Lap;
+  }
+
+  // Waits out a step another thread is part-way through and cannot fail,
+  // such as filling a claimed slot or linking the next segment.
+  template <typename Done> static void waitFor(Done done) {
+    for (std::size_t spins{}; !done(); ++spins) {
+      if (spins < 64)
+        cpuRelax();
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  // Claims up to maxCount slots at the tail, no further than the end of the
+  // tail segment, and calls make with the storage of each in order. Returns
+  // the number claimed. The next segment is taken before claiming a last slot,
+  // so that producers waiting for it are not held up by an allocation. If make
+  // throws, that slot and the rest of the run are left Skipped.
+  template <typename Make> std::size_t append(std::size_t maxCount, Make make) {
+    Segment *next{};
+    std::size_t count{};
+    auto tail{m_tail.index.load(std::memory_order_acquire)};
+    auto segment{m_tail.segment.load(std::memory_order_acquire)};
+    for (;;) {
+      const auto offset{offsetOf(tail)};
+      if (offset == SegmentSize) {
+        waitFor([&] {
+          tail = m_tail.index.load(std::memory_order_acquire);
+          return offsetOf(tail) != SegmentSize;
+        });
+        segment = m_tail.segment.load(std::memory_order_acquire);
+        continue;
+      }
+      count = std::min(maxCount, SegmentSize - offset);
+      if (offset + count == SegmentSize && !next)
+        next = takeSpare();
+      if (m_tail.index.compare_exchange_weak(tail, tail + count * Step,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_acquire))
+        break;
+      segment = m_tail.segment.load(std::memory_order_acquire);
+    }
+    const auto offset{offsetOf(tail)};
+    const auto end{offset + count};
+    if (end == SegmentSize) {
+      m_tail.segment.store(next, std::memory_order_release);
+      m_tail.index.store(tail + (count + 1) * Step, std::memory_order_release);
+      segment->next.store(next, std::memory_order_release);
+    } else if (next) {
+      recycle(next);
+    }
+    for (auto i{offset}; i < end; ++i) {
+      auto &slot{segment->slots[i]};
+      try {
+        make(slot.storage);
+      } catch (...) {
+        for (; i < end; ++i) {
+          segment->slots[i].state.store(Skipped, std::memory_order_release);
+        }
+        throw;
+      }
+      slot.state.store(Written, std::memory_order_release);
+    }
+    return count;
+  }
+
+  // Claims up to maxCount slots at the head, no further than the tail or the
+  // end of the head segment, and hands each written element to take in order.
+  // Returns the number claimed, which is 0 once the head meets the tail.
+  template <typename Take>
+  std::size_t consume(std::size_t maxCount, Take take) {
+    std::size_t count{};
+    auto head{m_head.index.load(std::memory_order_acquire)};
+    auto segment{m_head.segment.load(std::memory_order_acquire)};
+    auto next{head};
+    for (;;) {
+      const auto offset{offsetOf(head)};
+      if (offset == SegmentSize) {
+        waitFor([&] {
+          head = m_head.index.load(std::memory_order_acquire);
+          return offsetOf(head) != SegmentSize;
+        });
+        segment = m_head.segment.load(std::memory_order_acquire);
+        continue;
+      }
+      count = std::min(maxCount, SegmentSize - offset);
+      next = head;
+      if ((head & HasNext) == 0) {
+        const auto tail{m_tail.index.load()};
+        if (head / Step == tail / Step)
+          return 0;
+        if (lapOf(head) != lapOf(tail))
+          next |= HasNext;
+        else
+          count = std::min(count, offsetOf(tail) - offset);
+      }
+      next += count * Step;
+      if (m_head.index.compare_exchange_weak(head, next,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_acquire))
+        break;
+      segment = m_head.segment.load(std::memory_order_acquire);
+    }
+    const auto offset{offsetOf(head)};
+    const auto end{offset + count};
+    if (end == SegmentSize)
+      advanceHead(*segment, next);
+    auto i{offset};
+    try {
+      for (; i < end; ++i) {
+        read(segment->slots[i], take);
+      }
+    } catch (...) {
+      auto &slot{segment->slots[i]};
+      std::destroy_at(slot.element());
+      slot.state.store(Written | Read, std::memory_order_release);
+      while (++i < end) {
+        read(segment->slots[i], [](T &) {});
+      }
+      if (end == SegmentSize)
+        retire(segment);
+      throw;
+    }
+    if (end == SegmentSize)
+      retire(segment);
+    return count;
+  }
+
+  // Waits for a claimed slot's producer, hands the element to take unless its
+  // constructor threw, and marks the slot Read. The slot may be reused as soon
+  // as it is marked.
+  template <typename Take> static void read(Slot &slot, Take take) {
+    std::uint8_t state{};
+    waitFor([&] {
+      state = slot.state.load(std::memory_order_acquire);
+      return (state & (Written | Skipped)) != 0;
+    });
+    if (state & Written) {
+      take(*slot.element());
+      std::destroy_at(slot.element());
+    }
+    slot.state.store(state | Read, std::memory_order_release);
+  }
+
+  // The consumer of a segment's last slot moves the head on to the next
+  // segment, which the producer of that slot links right after claiming it.
+  void advanceHead(Segment &segment, std::size_t index) {
+    Segment *next{};
+    waitFor([&] {
+      next = segment.next.load(std::memory_order_acquire);
+      return next != nullptr;
+    });
+    auto following{(index & ~HasNext) + Step};
+    if (next->next.load(std::memory_order_relaxed))
+      following |= HasNext;
+    m_head.segment.store(next, std::memory_order_release);
+    m_head.index.store(following, std::memory_order_release);
+  }
+
+  // Called by the consumer of a segment's last slot once its own slots are
+  // read. Consumers of earlier slots may still be reading theirs, so the
+  // segment joins the retired list, and every retired segment whose slots are
+  // all read by now is recycled; the rest wait for the next segment to retire.
+  void retire(Segment *segment) {
+    segment->next.store(m_retired.exchange(nullptr, std::memory_order_acquire),
+                        std::memory_order_relaxed);
+    while (segment) {
+      auto next{segment->next.load(std::memory_order_relaxed)};
+      if (std::ranges::all_of(segment->slots, [](const Slot &slot) {
+            return slot.state.load(std::memory_order_acquire) & Read;
+          })) {
+        recycle(segment);
+      } else {
+        auto retired{m_retired.load(std::memory_order_relaxed)};
+        do {
+          segment->next.store(retired, std::memory_order_relaxed);
+        } while (!m_retired.compare_exchange_weak(retired, segment,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+      }
+      segment = next;
+    }
+  }
+
+  void recycle(Segment *segment) noexcept {
+    for (auto &slot : segment->slots) {
+      slot.state.store(0, std::memory_order_relaxed);
+    }
+    segment->next.store(nullptr, std::memory_order_relaxed);
+    delete m_spare.exchange(segment, std::memory_order_acq_rel);
+  }
+
+  Segment *takeSpare() {
+    auto segment{m_spare.exchange(nullptr, std::memory_order_acquire)};
+    return segment ? segment : new Segment;
+  }
+
+  template <typename OutputIt>
+  std::size_t popHeads(OutputIt &destination, std::size_t maxCount) {
+    std::size_t count{};
+    auto take{[&](T &element) {
+      *destination = std::move(element);
+      ++destination;
+      ++count;
+    }};
+    while (count < maxCount && consume(maxCount - count, take) != 0) {
+    }
+    return count;
+  }
+
+  // Claims are seq_cst compare-exchanges, and both hasWaiters and a consumer's
+  // read of the tail are seq_cst loads, so a consumer that registers as a
+  // waiter after the load sees the claim when it rechecks.
+  void notifyPushes(std::size_t count) {
+    if (count == 0 || !m_notEmpty.hasWaiters())
+      return;
+    if constexpr (WaitPolicy::RequiresWaitLock) {
+      const std::lock_guard waitLock{m_waitMutex};
+    }
+    if (count == 1)
+      m_notEmpty.notifyOne();
+    else
+      m_notEmpty.notifyAll();
+  }
+
+  End m_head;
+  End m_tail;
+  std::atomic<Segment *> m_retired{};
+  std::atomic<Segment *> m_spare{};
+  std::mutex m_waitMutex;
+  WaitPolicy m_notEmpty;
+};
+
+// Spreads elements over independent ConcurrentFreshQueue lanes so that threads
+// stop serialising on one head/tail pair. Each thread gets a home lane on first
+// use; pushes go to it and pops try it first before stealing from the other
+// lanes round-robin. Order is FIFO per lane only: elements pushed by one
+// thread come out in order, but elements from different threads may be popped
+// in any order, and a pop may find a younger element on its home lane while
+// an older one waits on another. Consumers block on one epoch shared by all
+// lanes, which pushes only touch while someone is waiting.
+template <typename T, typename Idle = SpinAtomicIdle<128>>
+class ShardedFreshQueue {
+public:
+  ShardedFreshQueue()
+      : ShardedFreshQueue{std::max(1u, std::thread::hardware_concurrency())} {}
+  explicit ShardedFreshQueue(std::size_t laneCount)
+      : m_laneCount{laneCount}, m_lanes{new Lane[laneCount]} {
+    if (laneCount == 0)
+      throw std::invalid_argument{"at least one lane is required"};
+  }
+  ShardedFreshQueue(const ShardedFreshQueue &) = delete;
+  ShardedFreshQueue(ShardedFreshQueue &&) noexcept = delete;
+  ShardedFreshQueue &operator=(const ShardedFreshQueue &) = delete;
+  ShardedFreshQueue &operator=(ShardedFreshQueue &&) noexcept = delete;
+  virtual ~ShardedFreshQueue() = default;
+
+  std::size_t laneCount() const noexcept { return m_laneCount; }
+
+  [[nodiscard]] bool empty() {
+    for (std::size_t i{}; i < m_laneCount; ++i) {
+      if (!m_lanes[i].queue.empty())
+        return false;
+    }
+    return true;
+  }
+
+  void push(const T &value) { emplace(value); }
+
+  void push(T &&value) { emplace(std::move(value)); }
+
+  template <typename... Args> void emplace(Args &&...args) {
+    m_lanes[homeLane()].queue.emplace(std::forward<Args>(args)...);
+    if (m_waiters != 0)
+      wakeOne();
+    m_asyncPops.resume(
+        1, [this](std::optional<T> &element) { return tryPopInto(element); });
+  }
+
+  bool tryPop(T &value) {
+    return steal([&](Lane &lane) { return lane.queue.tryPop(value); });
+  }
+
+  std::shared_ptr<T> tryPop() {
+    std::shared_ptr<T> result{};
+    steal([&](Lane &lane) { return bool(result = lane.queue.tryPop()); });
+    return result;
+  }
+
+  void waitAndPop(T &value) {
+    waitFor([&] { return tryPop(value); });
+  }
+
+  std::shared_ptr<T> waitAndPop() {
+    std::shared_ptr<T> result{};
+    waitFor([&] { return bool(result = tryPop()); });
+    return result;
+  }
+
+  // As ThreadSafeFreshQueue::asyncPop; a resumed coroutine may take its
+  // element from any lane.
+  template <typename Executor = InlineExecutor>
+  auto asyncPop(Executor executor = {}) {
+    return AsyncPop{
+        m_asyncPops,
+        [this](std::optional<T> &element) { return tryPopInto(element); },
+        std::move(executor)};
+  }
+
+private:
+  struct alignas(CacheLineSize) Lane {
+    ConcurrentFreshQueue<T> queue;
+  };
+
+  bool tryPopInto(std::optional<T> &element) {
+    return steal([&](Lane &lane) {
+      auto data{lane.queue.tryPop()};
+      if (data)
+        element.emplace(std::move(*data));
+      return bool(data);
+    });
+  }
+
+  // Threads are numbered in order of first use, so consecutive threads land
+  // on different lanes.
+  std::size_t homeLane() const noexcept {
+    static std::atomic<std::size_t> nextThread{};
+    thread_local const std::size_t thread{nextThread++};
+    return thread % m_laneCount;
+  }
+
+  template <typename Pop> bool steal(Pop pop) {
+    const auto home{homeLane()};
+    for (std::size_t i{}; i < m_laneCount; ++i) {
+      auto index{home + i};
+      if (index >= m_laneCount)
+        index -= m_laneCount;
+      if (pop(m_lanes[index]))
+        return true;
+    }
+    return false;
+  }
+
+  template <typename TryPop> void waitFor(TryPop tryPop) {
+    if (tryPop())
+      return;
+    ++m_waiters;
+    for (;;) {
+      auto epoch{m_epoch.load()};
+      if (tryPop())
+        break;
+      Idle::idle(m_epoch, epoch);
+    }
+    --m_waiters;
+  }
+
+  void wakeOne() noexcept {
+    ++m_epoch;
+    Idle::wake(m_epoch, false);
+  }
+
+  std::size_t m_laneCount;
+  std::unique_ptr<Lane[]> m_lanes;
+  AsyncPopWaiters<T> m_asyncPops;
+  alignas(CacheLineSize) std::atomic<std::size_t> m_waiters{};
+  alignas(CacheLineSize) std::atomic<std::uint32_t> m_epoch{};
+};
+
+// Keeps one locked FIFO lane per priority level, level 0 being the most urgent,
+// and a bitmap of the lanes that hold elements. Pops pick the lowest set bit,
+// so finding the most urgent work takes no lock, and lock only that lane. A
+// lane's bit is set and cleared under the lane's lock, so a pop that finds an
+// emptied lane just rereads the bitmap. Consumers share one wait point across
+// all levels, which pushes only touch while someone is waiting.
+template <typename T, std::size_t Levels = 8,
+          typename Idle = SpinAtomicIdle<128>>
+class PriorityFreshQueue {
+  static_assert(Levels >= 1 && Levels <= 64, "levels are bits of a uint64_t");
+
+public:
+  PriorityFreshQueue() = default;
+  PriorityFreshQueue(const PriorityFreshQueue &) = delete;
+  PriorityFreshQueue(PriorityFreshQueue &&) noexcept = delete;
+  PriorityFreshQueue &operator=(const PriorityFreshQueue &) = delete;
+  PriorityFreshQueue &operator=(PriorityFreshQueue &&) noexcept = delete;
+  virtual ~PriorityFreshQueue() = default;
+
+  static constexpr std::size_t levels() noexcept { return Levels; }
+
+  [[nodiscard]] bool empty() const noexcept { return m_nonEmpty == 0; }
+
+  void push(const T &value, std::size_t level) { emplace(level, value); }
+
+  void push(T &&value, std::size_t level) { emplace(level, std::move(value)); }
+
+  // Constructs the element from args in the lane for level.
+  template <typename... Args> void emplace(std::size_t level, Args &&...args) {
+    if (level >= Levels)
+      throw std::out_of_range{"priority level out of range"};
+    auto &lane{m_lanes[level]};
+    {
+      const std::lock_guard lock{lane.mutex};
+      lane.queue.emplace(std::forward<Args>(args)...);
+      if (lane.queue.size() == 1)
+        m_nonEmpty.fetch_or(std::uint64_t{1} << level);
+    }
+    if (m_waiters != 0) {
+      ++m_epoch;
+      Idle::wake(m_epoch, false);
+    }
+  }
+
+  bool tryPop(T &value) {
+    return popUrgent([&](std::queue<T> &queue) {
+      value = std::move(queue.front());
+    });
+  }
+
+  std::shared_ptr<T> tryPop() {
+    std::shared_ptr<T> result{};
+    popUrgent([&](std::queue<T> &queue) {
+      result = std::make_shared<T>(std::move(queue.front()));
+    });
+    return result;
+  }
+
+  void waitAndPop(T &value) {
+    waitFor([&] { return tryPop(value); });
+  }
+
+  std::shared_ptr<T> waitAndPop() {
+    std::shared_ptr<T> result{};
+    waitFor([&] { return bool(result = tryPop()); });
+    return result;
+  }
+
+private:
+  struct alignas(CacheLineSize) Lane {
+    std::mutex mutex;
+    std::queue<T> queue;
+  };
+
+  template <typename Take> bool popUrgent(Take take) {
+    for (;;) {
+      auto nonEmpty{m_nonEmpty.load()};
+      if (nonEmpty == 0)
+        return false;
+      auto level{static_cast<std::size_t>(std::countr_zero(nonEmpty))};
+      auto &lane{m_lanes[level]};
+      const std::lock_guard lock{lane.mutex};
+      if (lane.queue.empty())
+        continue;
+      take(lane.queue);
+      lane.queue.pop();
+      if (lane.queue.empty())
+        m_nonEmpty.fetch_and(~(std::uint64_t{1} << level));
+      return true;
+    }
+  }
+
+  template <typename TryPop> void waitFor(TryPop tryPop) {
+    if (tryPop())
+      return;
+    ++m_waiters;
+    for (;;) {
+      auto epoch{m_epoch.load()};
+      if (tryPop())
+        break;
+      Idle::idle(m_epoch, epoch);
+    }
+    --m_waiters;
+  }
+
+  std::array<Lane, Levels> m_lanes{};
+  alignas(CacheLineSize) std::atomic<std::uint64_t> m_nonEmpty{};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_waiters{};
+  alignas(CacheLineSize) std::atomic<std::uint32_t> m_epoch{};
+};
+
+// Bounded multi-producer/multi-consumer ring. Every slot carries a sequence
+// number that tells producers and consumers whose turn it is, so pushes and
+// pops only contend on a single atomic position each and nothing is allocated
+// per element.
+template <typename T, std::size_t Capacity = 1024> class LockFreeFreshQueue {
+  static_assert(Capacity >= 2 && std::has_single_bit(Capacity),
+                "capacity must be a power of two");
+  static_assert(std::is_nothrow_move_constructible_v<T> &&
+                    std::is_nothrow_move_assignable_v<T>,
+                "elements are moved in and out of claimed slots");
+
+private:
+  struct Slot {
+    Slot() {}
+    ~Slot() {}
+
+    std::atomic<std::size_t> sequence;
+    union {
+      T value;
+    };
+  };
+
+public:
+  LockFreeFreshQueue() : m_slots{new Slot[Capacity]} {
+    for (std::size_t i{}; i < Capacity; ++i) {
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  };
+  LockFreeFreshQueue(const LockFreeFreshQueue &) = delete;
+  LockFreeFreshQueue(LockFreeFreshQueue &&) noexcept = delete;
+  LockFreeFreshQueue &operator=(const LockFreeFreshQueue &) = delete;
+  LockFreeFreshQueue &operator=(LockFreeFreshQueue &&) noexcept = delete;
+  virtual ~LockFreeFreshQueue() {
+    while (consume([](T &) {}))
+      ;
+  }
+
+private:
+  static constexpr std::size_t Mask{Capacity - 1};
+
+  static std::ptrdiff_t distance(std::size_t from, std::size_t to) noexcept {
+    return static_cast<std::ptrdiff_t>(to - from);
+  }
+
+  // The element is constructed after its slot is claimed, which must not
+  // throw: a claimed slot that is never published would stall the ring.
+  template <typename... Args> bool produce(Args &&...args) noexcept {
+    static_assert(std::is_nothrow_constructible_v<T, Args...>);
+    auto position{m_pushPosition.load(std::memory_order_relaxed)};
+    for (;;) {
+      Slot &slot{m_slots[position & Mask]};
+      auto lag{distance(position,
+                        slot.sequence.load(std::memory_order_acquire))};
+      if (lag == 0) {
+        if (m_pushPosition.compare_exchange_weak(position, position + 1,
+                                                 std::memory_order_relaxed)) {
+          std::construct_at(&slot.value, std::forward<Args>(args)...);
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        position = m_pushPosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  template <typename Consumer> bool consume(Consumer &&consumer) noexcept {
+    auto position{m_popPosition.load(std::memory_order_relaxed)};
+    for (;;) {
+      Slot &slot{m_slots[position & Mask]};
+      auto lag{distance(position + 1,
+                        slot.sequence.load(std::memory_order_acquire))};
+      if (lag == 0) {
+        if (m_popPosition.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+          consumer(slot.value);
+          std::destroy_at(&slot.value);
+          slot.sequence.store(position + Capacity, std::memory_order_release);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        position = m_popPosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+public:
+  static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+  // Approximate while other threads are pushing or popping.
+  std::size_t size() const noexcept {
+    auto popPosition{m_popPosition.load(std::memory_order_acquire)};
+    auto pushPosition{m_pushPosition.load(std::memory_order_acquire)};
+    return distance(popPosition, pushPosition) > 0 ? pushPosition - popPosition
+                                                   : 0;
+  }
+
+  [[nodiscard]] bool empty() const noexcept {
+    auto position{m_popPosition.load(std::memory_order_acquire)};
+    return m_slots[position & Mask].sequence.load(std::memory_order_acquire) !=
+           position + 1;
+  }
+
+  bool tryPush(const T &value) { return produce(T(value)); }
+
+  bool tryPush(T &&value) noexcept { return produce(std::move(value)); }
+
+  void push(const T &value) { push(T(value)); }
+
+  void push(T &&value) { emplace(std::move(value)); }
+
+  // Constructs in place when that cannot throw, otherwise moves in a
+  // temporary.
+  template <typename... Args> void emplace(Args &&...args) {
+    if constexpr (std::is_nothrow_constructible_v<T, Args...>) {
+      while (!produce(std::forward<Args>(args)...)) {
+        std::this_thread::yield();
+      }
+    } else {
+      push(T(std::forward<Args>(args)...));
+    }
+  }
+
+  bool tryPop(T &value) noexcept {
+    return consume([&](T &element) { value = std::move(element); });
+  }
+
+  std::shared_ptr<T> tryPop() {
+    std::optional<T> element{};
+    if (!consume([&](T &slot) { element.emplace(std::move(slot)); }))
+      return {};
+    return std::make_shared<T>(std::move(*element));
+  }
+
+  void waitAndPop(T &value) {
+    while (!tryPop(value)) {
+      std::this_thread::yield();
+    }
+  }
+
+  std::shared_ptr<T> waitAndPop() {
+    for (;;) {
+      if (auto result{tryPop()})
+        return result;
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  std::unique_ptr<Slot[]> m_slots;
+  alignas(CacheLineSize) std::atomic<std::size_t> m_pushPosition{0};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_popPosition{0};
+};
+
+// Unbounded multi-producer/multi-consumer linked queue in the style of
+// Michael and Scott, for bursts too large to size a ring for. Both ends are
+// moved with compare-exchanges only and the head is always a dummy node whose
+// successor holds the next element. Pops retire the old dummy through a
+// FreshHazardDomain, so a node is only freed once no thread is still reading
+// it. The element is moved out of the new dummy after the head has moved past
+// it, when only the winning consumer can reach it, so move-only elements work.
+template <typename T, typename Idle = SpinAtomicIdle<128>>
+class UnboundedLockFreeFreshQueue {
+  struct Node {
+    std::atomic<Node *> next{};
+    std::optional<T> value{};
+  };
+
+public:
+  UnboundedLockFreeFreshQueue() {
+    auto dummy{new Node{}};
+    m_head.store(dummy, std::memory_order_relaxed);
+    m_tail.store(dummy, std::memory_order_relaxed);
+  }
+  UnboundedLockFreeFreshQueue(const UnboundedLockFreeFreshQueue &) = delete;
+  UnboundedLockFreeFreshQueue(UnboundedLockFreeFreshQueue &&) noexcept =
+      delete;
+  UnboundedLockFreeFreshQueue &
+  operator=(const UnboundedLockFreeFreshQueue &) = delete;
+  UnboundedLockFreeFreshQueue &
+  operator=(UnboundedLockFreeFreshQueue &&) noexcept = delete;
+  virtual ~UnboundedLockFreeFreshQueue() {
+    auto node{m_head.load(std::memory_order_relaxed)};
+    while (node) {
+      delete std::exchange(node, node->next.load(std::memory_order_relaxed));
+    }
+  }
+
+  [[nodiscard]] bool empty() const {
+    FreshHazardDomain::Guard guard{m_hazards};
+    auto head{guard.protect(0, m_head)};
+    return head->next.load() == nullptr;
+  }
+
+  void push(const T &value) { emplace(value); }
+
+  void push(T &&value) { emplace(std::move(value)); }
+
+  template <typename... Args> void emplace(Args &&...args) {
+    std::unique_ptr<Node> owner{new Node{}};
+    owner->value.emplace(std::forward<Args>(args)...);
+    auto node{owner.release()};
+    FreshHazardDomain::Guard guard{m_hazards};
+    for (;;) {
+      auto tail{guard.protect(0, m_tail)};
+      auto next{tail->next.load()};
+      if (next) {
+        m_tail.compare_exchange_weak(tail, next);
+        continue;
+      }
+      if (tail->next.compare_exchange_weak(next, node)) {
+        m_tail.compare_exchange_strong(tail, node);
+        break;
+      }
+    }
+    if (m_waiters != 0) {
+      ++m_epoch;
+      Idle::wake(m_epoch, false);
+    }
+  }
+
+  bool tryPop(T &value) {
+    FreshHazardDomain::Guard guard{m_hazards};
+    for (;;) {
+      auto head{guard.protect(0, m_head)};
+      auto next{guard.protect(1, head->next)};
+      if (head != m_head.load())
+        continue;
+      if (!next)
+        return false;
+      // A tail left behind on the dummy must be helped along before the head
+      // passes it, or it would point at a retired node.
+      auto tail{m_tail.load()};
+      if (head == tail) {
+        m_tail.compare_exchange_weak(tail, next);
+        continue;
+      }
+      if (m_head.compare_exchange_weak(head, next)) {
+        value = std::move(*next->value);
+        next->value.reset();
+        guard.clear(0);
+        guard.retire(head);
+        return true;
+      }
+    }
+  }
+
+  void waitAndPop(T &value) {
+    if (tryPop(value))
+      return;
+    ++m_waiters;
+    for (;;) {
+      auto epoch{m_epoch.load()};
+      if (tryPop(value))
+        break;
+      Idle::idle(m_epoch, epoch);
+    }
+    --m_waiters;
+  }
+
+private:
+  mutable FreshHazardDomain m_hazards;
+  alignas(CacheLineSize) std::atomic<Node *> m_head{};
+  alignas(CacheLineSize) std::atomic<Node *> m_tail{};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_waiters{};
+  alignas(CacheLineSize) std::atomic<std::uint32_t> m_epoch{};
+};
+
+// Ring for exactly one producer thread and one consumer thread. Each side owns
+// its index on a separate cache line and keeps a cached copy of the other
+// side's index, so the shared line is only read when the cached view says the
+// ring is full or empty.
+template <typename T, std::size_t Capacity = 1024> class SpscFreshQueue {
+  static_assert(Capacity >= 2 && std::has_single_bit(Capacity),
+                "capacity must be a power of two");
+
+private:
+  struct Slot {
+    Slot() {}
+    ~Slot() {}
+
+    union {
+      T value;
+    };
+  };
+
+public:
+  SpscFreshQueue() : m_slots{new Slot[Capacity]} {};
+  SpscFreshQueue(const SpscFreshQueue &) = delete;
+  SpscFreshQueue(SpscFreshQueue &&) noexcept = delete;
+  SpscFreshQueue &operator=(const SpscFreshQueue &) = delete;
+  SpscFreshQueue &operator=(SpscFreshQueue &&) noexcept = delete;
+  virtual ~SpscFreshQueue() {
+    while (consume([](T &) {}))
+      ;
+  }
+
+private:
+  static constexpr std::size_t Mask{Capacity - 1};
+
+  template <typename... Args> bool produce(Args &&...args) {
+    auto tail{m_tail.load(std::memory_order_relaxed)};
+    if (tail - m_cachedHead == Capacity) {
+      m_cachedHead = m_head.load(std::memory_order_acquire);
+      if (tail - m_cachedHead == Capacity)
+        return false;
+    }
+    std::construct_at(&m_slots[tail & Mask].value,
+                      std::forward<Args>(args)...);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename Consumer> bool consume(Consumer &&consumer) {
+    auto head{m_head.load(std::memory_order_relaxed)};
+    if (head == m_cachedTail) {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head == m_cachedTail)
+        return false;
+    }
+    T &element{m_slots[head & Mask].value};
+    consumer(element);
+    std::destroy_at(&element);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+public:
+  static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+  std::size_t size() const noexcept {
+    auto head{m_head.load(std::memory_order_acquire)};
+    return m_tail.load(std::memory_order_acquire) - head;
+  }
+
+  [[nodiscard]] bool empty() const noexcept {
+    return m_head.load(std::memory_order_acquire) ==
+           m_tail.load(std::memory_order_acquire);
+  }
+
+  bool tryPush(const T &value) { return produce(value); }
+
+  bool tryPush(T &&value) { return produce(std::move(value)); }
+
+  void push(const T &value) { emplace(value); }
+
+  void push(T &&value) { emplace(std::move(value)); }
+
+  template <typename... Args> void emplace(Args &&...args) {
+    while (!produce(std::forward<Args>(args)...)) {
+      std::this_thread::yield();
+    }
+  }
+
+  bool tryPop(T &value) {
+    return consume([&](T &element) { value = std::move(element); });
+  }
+
+  std::shared_ptr<T> tryPop() {
+    std::shared_ptr<T> result{};
+    consume([&](T &element) {
+      result = std::make_shared<T>(std::move(element));
+    });
+    return result;
+  }
+
+  void waitAndPop(T &value) {
+    while (!tryPop(value)) {
+      std::this_thread::yield();
+    }
+  }
+
+  std::shared_ptr<T> waitAndPop() {
+    for (;;) {
+      if (auto result{tryPop()})
+        return result;
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  std::unique_ptr<Slot[]> m_slots;
+  alignas(CacheLineSize) std::atomic<std::size_t> m_head{0};
+  std::size_t m_cachedTail{0};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_tail{0};
+  std::size_t m_cachedHead{0};
+};
+
+// Ring that hands every element to every consumer, in the manner of the LMAX
+// Disruptor. Producers write each element once into a preallocated slot and
+// each consumer is a Cursor that walks the ring at its own pace, copying
+// elements out. A cursor subscribed after others only reads elements that
+// all of those have finished with, so a persister can run strictly behind a
+// risk check. A producer waits until the slowest cursor has left the slot it
+// is about to overwrite. Cursors must subscribe before the first push and are
+// owned by the queue. Slots keep their elements until overwritten, so T must
+// be default constructible and copy assignable. Cursors and producers wait at
+// separate points: a pop only wakes cursors subscribed after its own, and
+// wakes producers waiting for room only if its cursor was the slowest.
+template <typename T, std::size_t Capacity = 1024,
+          typename Idle = SpinAtomicIdle<128>>
+class BroadcastFreshQueue {
+  static_assert(Capacity >= 2 && std::has_single_bit(Capacity),
+                "capacity must be a power of two");
+  static_assert(std::is_default_constructible_v<T> &&
+                    std::is_copy_assignable_v<T>,
+                "slots are preallocated and overwritten in place");
+
+public:
+  class Cursor {
+  public:
+    Cursor(const Cursor &) = delete;
+    Cursor(Cursor &&) noexcept = delete;
+    Cursor &operator=(const Cursor &) = delete;
+    Cursor &operator=(Cursor &&) noexcept = delete;
+    virtual ~Cursor() = default;
+
+    // Elements pushed but not yet read through this cursor.
+    std::size_t backlog() const noexcept {
+      auto next{m_next.load(std::memory_order_acquire)};
+      return m_queue.m_claim.load(std::memory_order_acquire) - next;
+    }
+
+    bool tryPop(T &value) { return m_queue.consume(*this, value); }
+
+    void waitAndPop(T &value) {
+      m_queue.m_published.wait([&] { return tryPop(value); });
+    }
+
+  private:
+    friend class BroadcastFreshQueue;
+
+    Cursor(BroadcastFreshQueue &queue, std::vector<const Cursor *> after)
+        : m_queue{queue}, m_after{std::move(after)} {}
+
+    BroadcastFreshQueue &m_queue;
+    std::vector<const Cursor *> m_after;
+    bool m_followed{false};
+    alignas(CacheLineSize) std::atomic<std::size_t> m_next{0};
+  };
+
+  BroadcastFreshQueue() : m_slots{new Slot[Capacity]} {}
+  BroadcastFreshQueue(const BroadcastFreshQueue &) = delete;
+  BroadcastFreshQueue(BroadcastFreshQueue &&) noexcept = delete;
+  BroadcastFreshQueue &operator=(const BroadcastFreshQueue &) = delete;
+  BroadcastFreshQueue &operator=(BroadcastFreshQueue &&) noexcept = delete;
+  virtual ~BroadcastFreshQueue() = default;
+
+  static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+  // Not safe against concurrent pushes, hence the check for the first one.
+  Cursor &subscribe(std::initializer_list<const Cursor *> after = {}) {
+    if (m_claim.load() != 0)
+      throw std::logic_error{"cursors must subscribe before the first push"};
+    for (auto cursor : after) {
+      if (cursor == nullptr || &cursor->m_queue != this)
+        throw std::invalid_argument{"cursor belongs to another queue"};
+    }
+    for (auto cursor : after) {
+      const_cast<Cursor *>(cursor)->m_followed = true;
+    }
+    m_cursors.push_back(std::unique_ptr<Cursor>{new Cursor{*this, after}});
+    return *m_cursors.back();
+  }
+
+  bool tryPush(const T &value) {
+    auto sequence{m_claim.load(std::memory_order_relaxed)};
+    do {
+      if (!hasRoom(sequence))
+        return false;
+    } while (!m_claim.compare_exchange_weak(sequence, sequence + 1,
+                                            std::memory_order_relaxed));
+    publish(sequence, value);
+    return true;
+  }
+
+  void push(const T &value) {
+    auto sequence{m_claim.fetch_add(1, std::memory_order_relaxed)};
+    m_room.wait([&] { return hasRoom(sequence); });
+    publish(sequence, value);
+  }
+
+private:
+  static constexpr std::size_t Mask{Capacity - 1};
+
+  struct Slot {
+    std::atomic<std::size_t> published{0};
+    T value{};
+  };
+
+  // The gate is raised to the slowest cursor's position whenever a producer
+  // finds it too far behind, so it never passes any cursor, and only cursors
+  // at the gate wake producers. A producer that is about to wait rechecks
+  // after raising the gate: either it sees a cursor that moved meanwhile, or
+  // that cursor sees the raised gate. Without cursors nothing is kept.
+  bool hasRoom(std::size_t sequence) noexcept {
+    if (m_cursors.empty() ||
+        sequence < m_gate.load(std::memory_order_acquire) + Capacity)
+      return true;
+    auto slowest{slowestCursor()};
+    for (;;) {
+      auto gate{m_gate.load()};
+      while (gate < slowest && !m_gate.compare_exchange_weak(gate, slowest)) {
+      }
+      if (sequence < slowest + Capacity)
+        return true;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto again{slowestCursor()};
+      if (again == slowest)
+        return false;
+      slowest = again;
+    }
+  }
+
+  std::size_t slowestCursor() const noexcept {
+    auto slowest{std::numeric_limits<std::size_t>::max()};
+    for (auto &cursor : m_cursors) {
+      slowest =
+          std::min(slowest, cursor->m_next.load(std::memory_order_acquire));
+    }
+    return slowest;
+  }
+
+  void publish(std::size_t sequence, const T &value) {
+    Slot &slot{m_slots[sequence & Mask]};
+    slot.value = value;
+    slot.published.store(sequence + 1, std::memory_order_release);
+    m_published.notify();
+  }
+
+  bool consume(Cursor &cursor, T &value) {
+    auto next{cursor.m_next.load(std::memory_order_relaxed)};
+    Slot &slot{m_slots[next & Mask]};
+    if (slot.published.load(std::memory_order_acquire) != next + 1)
+      return false;
+    for (auto before : cursor.m_after) {
+      if (before->m_next.load(std::memory_order_acquire) <= next)
+        return false;
+    }
+    value = slot.value;
+    cursor.m_next.store(next + 1, std::memory_order_release);
+    if (cursor.m_followed)
+      m_published.notify();
+    m_room.notifyIf([&] { return next <= m_gate.load(); });
+    return true;
+  }
+
+  // Wakes every waiter, since each cursor wants every element. The fence
+  // orders the store that made progress before the waiter count is read,
+  // against a waiter registering before it rechecks.
+  struct WaitPoint {
+    template <typename Wanted> void notifyIf(Wanted wanted) noexcept {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters.load(std::memory_order_relaxed) != 0 && wanted()) {
+        ++epoch;
+        Idle::wake(epoch, true);
+      }
+    }
+
+    void notify() noexcept {
+      notifyIf([] { return true; });
+    }
+
+    template <typename Ready> void wait(Ready ready) {
+      if (ready())
+        return;
+      ++waiters;
+      for (;;) {
+        auto seen{epoch.load()};
+        if (ready())
+          break;
+        Idle::idle(epoch, seen);
+      }
+      --waiters;
+    }
+
+    alignas(CacheLineSize) std::atomic<std::size_t> waiters{};
+    alignas(CacheLineSize) std::atomic<std::uint32_t> epoch{};
+  };
+
+  std::unique_ptr<Slot[]> m_slots;
+  std::vector<std::unique_ptr<Cursor>> m_cursors;
+  alignas(CacheLineSize) std::atomic<std::size_t> m_claim{0};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_gate{0};
+  WaitPoint m_published;
+  WaitPoint m_room;
+};
+
+// Policies describing the concurrency shape a FreshQueue is declared for.
+// Counts other than one mean "more than one"; ManyThreads says so explicitly.
+inline constexpr std::size_t ManyThreads{
+    std::numeric_limits<std::size_t>::max()};
+
+template <std::size_t Count = ManyThreads> struct Producers {
+  static_assert(Count != 0, "a queue needs at least one producer");
+  static constexpr std::size_t count{Count};
+};
+
+template <std::size_t Count = ManyThreads> struct Consumers {
+  static_assert(Count != 0, "a queue needs at least one consumer");
+  static constexpr std::size_t count{Count};
+};
+
+template <std::size_t Count = UnboundedCapacity> struct Capacity {
+  static_assert(Count != 0, "a bounded queue needs room for an element");
+  static constexpr std::size_t count{Count};
+};
+
+template <typename Policy = CondVarWait> struct Wait {
+  using policy = Policy;
+};
+
+template <typename Policy>
+concept ProducersPolicy = std::same_as<Policy, Producers<Policy::count>>;
+template <typename Policy>
+concept ConsumersPolicy = std::same_as<Policy, Consumers<Policy::count>>;
+template <typename Policy>
+concept CapacityPolicy = std::same_as<Policy, Capacity<Policy::count>>;
+template <typename Policy>
+concept WaitingPolicy = std::same_as<Policy, Wait<typename Policy::policy>>;
+
+template <typename Policy> struct EpochWaitIdle {};
+template <typename Idle> struct EpochWaitIdle<EpochWait<Idle>> {
+  using type = Idle;
+};
+
+// Waits that watch an epoch and so can drive the lock-free backends.
+template <typename Policy>
+concept EpochWaitPolicy = requires { typename EpochWaitIdle<Policy>::type; };
+
+template <typename Idle> inline constexpr bool NeverSleeps{false};
+template <> inline constexpr bool NeverSleeps<BusySpinIdle>{true};
+template <std::size_t Spins>
+inline constexpr bool NeverSleeps<SpinYieldIdle<Spins>>{true};
+
+// Waits that never sleep in the kernel, which the rings can honour by
+// yielding since they have nobody to wake.
+template <typename Policy>
+concept SpinningWaitPolicy =
+    EpochWaitPolicy<Policy> &&
+    NeverSleeps<typename EpochWaitIdle<Policy>::type>;
+
+template <typename T, std::size_t ProducerCount, std::size_t ConsumerCount,
+          std::size_t CapacityCount, typename WaitPolicy>
+struct FreshQueueShape {
+  using Element = T;
+  using Wait = WaitPolicy;
+  static constexpr bool singleProducer{ProducerCount == 1};
+  static constexpr bool singleConsumer{ConsumerCount == 1};
+  static constexpr bool bounded{CapacityCount != UnboundedCapacity};
+  static constexpr std::size_t capacity{CapacityCount};
+};
+
+// A bounded shape whose waits spin fits in a ring, if the capacity is a power
+// of two and elements move and move-assign without throwing.
+template <typename Shape>
+concept RingShape =
+    Shape::bounded && Shape::capacity >= 2 &&
+    std::has_single_bit(Shape::capacity) &&
+    SpinningWaitPolicy<typename Shape::Wait> &&
+    std::is_nothrow_move_constructible_v<typename Shape::Element> &&
+    std::is_nothrow_move_assignable_v<typename Shape::Element>;
+
+template <typename Shape>
+concept SpscRingShape =
+    RingShape<Shape> && Shape::singleProducer && Shape::singleConsumer;
+
+template <typename Shape>
+concept MpmcRingShape =
+    RingShape<Shape> && !(Shape::singleProducer && Shape::singleConsumer);
+
+// Contention on both ends is where the linked lock-free queue pulls ahead of
+// the locked ones.
+template <typename Shape>
+concept LockFreeListShape =
+    !Shape::bounded && !Shape::singleProducer && !Shape::singleConsumer &&
+    EpochWaitPolicy<typename Shape::Wait>;
+
+// Everything else: bounded shapes get a ConcurrentFreshQueue sized at run
+// time, unbounded ones a SegmentedFreshQueue, which allocates a segment per
+// SegmentSize elements instead of a node per element.
+template <typename Shape> struct FreshQueueBackend {
+  using type = std::conditional_t<
+      Shape::bounded,
+      ConcurrentFreshQueue<typename Shape::Element,
+                           std::allocator<typename Shape::Element>,
+                           typename Shape::Wait>,
+      SegmentedFreshQueue<typename Shape::Element, 64, typename Shape::Wait>>;
+};
+
+template <SpscRingShape Shape> struct FreshQueueBackend<Shape> {
+  using type = SpscFreshQueue<typename Shape::Element, Shape::capacity>;
+};
+
+template <MpmcRingShape Shape> struct FreshQueueBackend<Shape> {
+  using type = LockFreeFreshQueue<typename Shape::Element, Shape::capacity>;
+};
+
+template <LockFreeListShape Shape> struct FreshQueueBackend<Shape> {
+  using type = UnboundedLockFreeFreshQueue<
+      typename Shape::Element,
+      typename EpochWaitIdle<typename Shape::Wait>::type>;
+};
+
+// One queue type for every concurrency shape: the declared producers,
+// consumers, capacity and wait pick the fastest backend at compile time, and
+// all of them are driven through the same calls. push and emplace wait for
+// room when the queue is bounded, pop throws EmptyQueue where tryPop returns
+// false, and waitAndPop waits as the Wait policy says. Rings wait by yielding,
+// so they are only chosen for the spinning waits. size() is left out since
+// the unbounded backends do not count their elements. Declaring one producer
+// or consumer is a promise: a second thread on that end of an SPSC ring is
+// undefined behaviour.
+template <typename T, ProducersPolicy ProducerPolicy = Producers<>,
+          ConsumersPolicy ConsumerPolicy = Consumers<>,
+          CapacityPolicy CapacityLimit = Capacity<>,
+          WaitingPolicy WaitStrategy = Wait<>>
+class FreshQueue {
+  static_assert(std::is_move_constructible_v<T> && std::is_move_assignable_v<T>,
+                "elements are moved in and out of every backend");
+  static_assert(std::same_as<typename WaitStrategy::policy, CondVarWait> ||
+                    EpochWaitPolicy<typename WaitStrategy::policy>,
+                "Wait takes CondVarWait or an EpochWait policy");
+
+public:
+  using Shape =
+      FreshQueueShape<T, ProducerPolicy::count, ConsumerPolicy::count,
+                      CapacityLimit::count, typename WaitStrategy::policy>;
+  using Backend = typename FreshQueueBackend<Shape>::type;
+
+  FreshQueue() : m_queue{makeBackend()} {}
+  FreshQueue(const FreshQueue &) = delete;
+  FreshQueue(FreshQueue &&) noexcept = delete;
+  FreshQueue &operator=(const FreshQueue &) = delete;
+  FreshQueue &operator=(FreshQueue &&) noexcept = delete;
+  virtual ~FreshQueue() = default;
+
+  static constexpr std::size_t capacity() noexcept { return Shape::capacity; }
+
+  [[nodiscard]] bool empty() { return m_queue.empty(); }
+
+  void push(const T &value) { m_queue.push(value); }
+
+  void push(T &&value) { m_queue.push(std::move(value)); }
+
+  template <typename... Args> void emplace(Args &&...args) {
+    m_queue.emplace(std::forward<Args>(args)...);
+  }
+
+  // Only fails on a full bounded queue, leaving value as it was.
+  bool tryPush(const T &value) {
+    if constexpr (Shape::bounded) {
+      return m_queue.tryPush(value);
+    } else {
+      m_queue.push(value);
+      return true;
+    }
+  }
+
+  bool tryPush(T &&value) {
+    if constexpr (Shape::bounded) {
+      return m_queue.tryPush(std::move(value));
+    } else {
+      m_queue.push(std::move(value));
+      return true;
+    }
+  }
+
+  bool tryPop(T &value) { return m_queue.tryPop(value); }
+
+  void pop(T &value) {
+    if (!m_queue.tryPop(value))
+      throw EmptyQueue{};
+  }
+
+  void waitAndPop(T &value) { m_queue.waitAndPop(value); }
+
+private:
+  static Backend makeBackend() {
+    if constexpr (std::is_constructible_v<Backend, std::size_t>)
+      return Backend{Shape::capacity};
+    else
+      return Backend{};
+  }
+
+  Backend m_queue;
 };
@@ -0,0 +1,238 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "freshqueue.h"
+
+// A named POSIX shared-memory object mapped into this process. The process
+// that creates it unlinks the name again on destruction; other processes'
+// mappings stay valid until they are destroyed in turn. Failures throw
+// std::system_error carrying errno.
+class FreshSharedMemory {
+public:
+  static FreshSharedMemory create(const std::string &name, std::size_t size);
+  static FreshSharedMemory attach(const std::string &name);
+  FreshSharedMemory(const FreshSharedMemory &) = delete;
+  FreshSharedMemory(FreshSharedMemory &&) noexcept = delete;
+  FreshSharedMemory &operator=(const FreshSharedMemory &) = delete;
+  FreshSharedMemory &operator=(FreshSharedMemory &&) noexcept = delete;
+  virtual ~FreshSharedMemory();
+
+  const std::string &name() const noexcept { return m_name; }
+  void *data() const noexcept { return m_data; }
+  std::size_t size() const noexcept { return m_size; }
+
+private:
+  FreshSharedMemory(std::string name, void *data, std::size_t size,
+                    bool owner) noexcept
+      : m_name{std::move(name)}, m_data{data}, m_size{size}, m_owner{owner} {}
+
+  std::string m_name;
+  void *m_data;
+  std::size_t m_size;
+  bool m_owner;
+};
+
+// Blocks while word holds expected, across processes: the word may live in
+// memory that other processes have mapped. Returns on a wake-up, which may be
+// spurious, so callers recheck their condition.
+void futexWait(std::atomic<std::uint32_t> &word,
+               std::uint32_t expected) noexcept;
+void futexWake(std::atomic<std::uint32_t> &word, int count) noexcept;
+
+// LockFreeFreshQueue's sequenced ring laid out in a FreshSharedMemory object,
+// so that processes exchange elements without sockets, serialisation or a
+// system call per message. One process creates the queue under a name and
+// others attach to it; attach checks that the object was created for the same
+// element size and capacity. Elements are copied bytewise, so T must be
+// trivially copyable and must not point into any one process's memory.
+// Blocked pushes and pops sleep on process-shared futexes that the other side
+// only wakes while someone is registered as waiting.
+template <typename T, std::size_t Capacity = 1024>
+class SharedMemoryFreshQueue {
+  static_assert(Capacity >= 2 && std::has_single_bit(Capacity),
+                "capacity must be a power of two");
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are copied between processes bytewise");
+  static_assert(std::atomic<std::size_t>::is_always_lock_free &&
+                    std::atomic<std::uint32_t>::is_always_lock_free,
+                "atomics in shared memory must not rely on a process's lock");
+
+private:
+  static constexpr std::uint64_t Magic{0x4672'6573'6851'0001};
+  static constexpr std::size_t Mask{Capacity - 1};
+
+  struct Slot {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  struct WaitPoint {
+    alignas(CacheLineSize) std::atomic<std::uint32_t> epoch;
+    std::atomic<std::uint32_t> waiters;
+  };
+
+  // Value-initialised by the creating process, which publishes magic last.
+  struct Layout {
+    std::atomic<std::uint64_t> magic;
+    std::uint64_t capacity;
+    std::uint64_t elementSize;
+    alignas(CacheLineSize) std::atomic<std::size_t> pushPosition;
+    alignas(CacheLineSize) std::atomic<std::size_t> popPosition;
+    WaitPoint notEmpty;
+    WaitPoint notFull;
+    alignas(CacheLineSize) Slot slots[Capacity];
+  };
+
+  SharedMemoryFreshQueue(const std::string &name, bool creating)
+      : m_memory{creating ? FreshSharedMemory::create(name, sizeof(Layout))
+                          : FreshSharedMemory::attach(name)},
+        m_layout{creating ? std::construct_at(
+                                static_cast<Layout *>(m_memory.data()))
+                          : std::launder(static_cast<Layout *>(
+                                m_memory.data()))} {
+    if (creating) {
+      for (std::size_t i{}; i < Capacity; ++i) {
+        m_layout->slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      m_layout->capacity = Capacity;
+      m_layout->elementSize = sizeof(T);
+      m_layout->magic.store(Magic, std::memory_order_release);
+    } else if (m_memory.size() < sizeof(Layout) ||
+               m_layout->magic.load(std::memory_order_acquire) != Magic ||
+               m_layout->capacity != Capacity ||
+               m_layout->elementSize != sizeof(T)) {
+      throw std::runtime_error{"shared memory does not hold a matching queue"};
+    }
+  }
+
+public:
+  static SharedMemoryFreshQueue create(const std::string &name) {
+    return SharedMemoryFreshQueue{name, true};
+  }
+  static SharedMemoryFreshQueue attach(const std::string &name) {
+    return SharedMemoryFreshQueue{name, false};
+  }
+  SharedMemoryFreshQueue(const SharedMemoryFreshQueue &) = delete;
+  SharedMemoryFreshQueue(SharedMemoryFreshQueue &&) noexcept = delete;
+  SharedMemoryFreshQueue &operator=(const SharedMemoryFreshQueue &) = delete;
+  SharedMemoryFreshQueue &
+  operator=(SharedMemoryFreshQueue &&) noexcept = delete;
+  virtual ~SharedMemoryFreshQueue() = default;
+
+  static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+  const std::string &name() const noexcept { return m_memory.name(); }
+
+  [[nodiscard]] bool empty() const noexcept {
+    auto position{m_layout->popPosition.load(std::memory_order_acquire)};
+    return m_layout->slots[position & Mask].sequence.load(
+               std::memory_order_acquire) != position + 1;
+  }
+
+  bool tryPush(const T &value) noexcept {
+    if (!produce(value))
+      return false;
+    signal(m_layout->notEmpty);
+    return true;
+  }
+
+  void push(const T &value) {
+    waitUntil(m_layout->notFull, [&] { return produce(value); });
+    signal(m_layout->notEmpty);
+  }
+
+  bool tryPop(T &value) noexcept {
+    if (!consume(value))
+      return false;
+    signal(m_layout->notFull);
+    return true;
+  }
+
+  void waitAndPop(T &value) {
+    waitUntil(m_layout->notEmpty, [&] { return consume(value); });
+    signal(m_layout->notFull);
+  }
+
+private:
+  static std::ptrdiff_t distance(std::size_t from, std::size_t to) noexcept {
+    return static_cast<std::ptrdiff_t>(to - from);
+  }
+
+  bool produce(const T &value) noexcept {
+    auto &position{m_layout->pushPosition};
+    auto current{position.load(std::memory_order_relaxed)};
+    for (;;) {
+      Slot &slot{m_layout->slots[current & Mask]};
+      auto lag{
+          distance(current, slot.sequence.load(std::memory_order_acquire))};
+      if (lag == 0) {
+        if (position.compare_exchange_weak(current, current + 1,
+                                           std::memory_order_relaxed)) {
+          slot.value = value;
+          slot.sequence.store(current + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        current = position.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool consume(T &value) noexcept {
+    auto &position{m_layout->popPosition};
+    auto current{position.load(std::memory_order_relaxed)};
+    for (;;) {
+      Slot &slot{m_layout->slots[current & Mask]};
+      auto lag{distance(current + 1,
+                        slot.sequence.load(std::memory_order_acquire))};
+      if (lag == 0) {
+        if (position.compare_exchange_weak(current, current + 1,
+                                           std::memory_order_relaxed)) {
+          value = slot.value;
+          slot.sequence.store(current + Capacity, std::memory_order_release);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        current = position.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // As EpochWait, with a futex in place of the idle strategy: the epoch is
+  // read before each attempt, so a signal after a failed attempt changes it.
+  template <typename Attempt>
+  static void waitUntil(WaitPoint &point, Attempt attempt) {
+    if (attempt())
+      return;
+    ++point.waiters;
+    for (;;) {
+      auto epoch{point.epoch.load()};
+      if (attempt())
+        break;
+      futexWait(point.epoch, epoch);
+    }
+    --point.waiters;
+  }
+
+  static void signal(WaitPoint &point) noexcept {
+    if (point.waiters.load() == 0)
+      return;
+    ++point.epoch;
+    futexWake(point.epoch, 1);
+  }
+
+  FreshSharedMemory m_memory;
+  Layout *m_layout;
+};
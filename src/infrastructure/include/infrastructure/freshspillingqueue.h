@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+
+#include "freshqueue.h"
+
+// A fixed-size file in a spill directory that can be mapped read-write on
+// demand. The file is unlinked as soon as it is created, so it only lives as
+// long as this object and nothing is left behind if the process dies. While
+// unmapped, its pages count against the page cache rather than the process.
+// Failures throw std::system_error carrying errno.
+class FreshSpillFile {
+public:
+  FreshSpillFile(const std::filesystem::path &directory, std::size_t size);
+  FreshSpillFile(const FreshSpillFile &) = delete;
+  FreshSpillFile(FreshSpillFile &&) noexcept = delete;
+  FreshSpillFile &operator=(const FreshSpillFile &) = delete;
+  FreshSpillFile &operator=(FreshSpillFile &&) noexcept = delete;
+  virtual ~FreshSpillFile();
+
+  std::size_t size() const noexcept { return m_size; }
+
+  void *map();
+  void unmap() noexcept;
+
+private:
+  int m_descriptor;
+  std::size_t m_size;
+  void *m_data{};
+};
+
+// A locked queue for bursts that outrun the consumers. Up to memoryLimit
+// elements are kept in memory; beyond that, new elements are appended to
+// SegmentSize-element spill files in the given directory, and a file is
+// unmapped as soon as it is full so the pages it holds stop counting towards
+// the process's resident set. Elements in memory are always older than spilled
+// ones: pushes keep spilling until consumers have caught up with every spill
+// file, and an empty in-memory head is refilled from the oldest file at most
+// RefillSize elements at a time, so no caller holds the lock for a whole
+// segment copy. Resident memory therefore stays within about memoryLimit plus
+// two segments. Elements are written to the files bytewise, so T must be
+// trivially copyable; that is why this is not a mode of ThreadSafeFreshQueue,
+// whose hot path stays as it was.
+template <typename T, std::size_t SegmentSize = 1 << 16,
+          typename WaitPolicy = CondVarWait>
+class SpillingFreshQueue {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are spilled to files bytewise");
+  static_assert(SegmentSize > 0, "segments need at least one element");
+
+public:
+  static constexpr std::size_t RefillSize{std::min<std::size_t>(SegmentSize,
+                                                                1024)};
+
+  SpillingFreshQueue(std::filesystem::path directory, std::size_t memoryLimit)
+      : m_directory{std::move(directory)}, m_memoryLimit{memoryLimit} {
+    if (memoryLimit == 0)
+      throw std::invalid_argument{"memory limit must be positive"};
+    if (!std::filesystem::is_directory(m_directory))
+      throw std::invalid_argument{"spill directory does not exist"};
+  }
+  SpillingFreshQueue(const SpillingFreshQueue &) = delete;
+  SpillingFreshQueue(SpillingFreshQueue &&) noexcept = delete;
+  SpillingFreshQueue &operator=(const SpillingFreshQueue &) = delete;
+  SpillingFreshQueue &operator=(SpillingFreshQueue &&) noexcept = delete;
+  virtual ~SpillingFreshQueue() = default;
+
+  std::size_t memoryLimit() const noexcept { return m_memoryLimit; }
+
+  std::size_t size() const {
+    const std::lock_guard lock{m_mutex};
+    return m_memory.size() + m_spilledCount;
+  }
+
+  // Elements currently held in spill files rather than in memory.
+  std::size_t spilled() const {
+    const std::lock_guard lock{m_mutex};
+    return m_spilledCount;
+  }
+
+  [[nodiscard]] bool empty() const {
+    const std::lock_guard lock{m_mutex};
+    return m_memory.empty() && m_spilledCount == 0;
+  }
+
+  void push(const T &value) {
+    {
+      const std::lock_guard lock{m_mutex};
+      if (m_spilled.empty() && m_memory.size() < m_memoryLimit)
+        m_memory.push_back(value);
+      else
+        spill(value);
+    }
+    if (m_notEmpty.hasWaiters())
+      m_notEmpty.notifyOne();
+  }
+
+  bool tryPop(T &value) {
+    const std::lock_guard lock{m_mutex};
+    if (!hasFront())
+      return false;
+    popFront(value);
+    return true;
+  }
+
+  void waitAndPop(T &value) {
+    std::unique_lock lock{m_mutex};
+    m_notEmpty.wait(lock, [&] { return hasFront(); });
+    popFront(value);
+  }
+
+private:
+  struct Segment {
+    std::unique_ptr<FreshSpillFile> file;
+    std::size_t begin{};
+    std::size_t end{};
+  };
+
+  // Called with the lock held.
+  void spill(const T &value) {
+    if (m_spilled.empty() || m_spilled.back().end == SegmentSize) {
+      if (!m_spilled.empty())
+        m_spilled.back().file->unmap();
+      m_spilled.push_back(Segment{std::make_unique<FreshSpillFile>(
+                                      m_directory, SegmentSize * sizeof(T)),
+                                  0, 0});
+    }
+    auto &tail{m_spilled.back()};
+    std::memcpy(static_cast<std::byte *>(tail.file->map()) +
+                    tail.end * sizeof(T),
+                &value, sizeof(T));
+    ++tail.end;
+    ++m_spilledCount;
+  }
+
+  // Called with the lock held. Refills an empty head with the next chunk of
+  // the oldest spill file, which is dropped once read to the end; if it was
+  // still being written, the next spilled push starts a new one.
+  bool hasFront() {
+    if (m_memory.empty() && !m_spilled.empty()) {
+      auto &oldest{m_spilled.front()};
+      auto slots{static_cast<const std::byte *>(oldest.file->map())};
+      const auto end{std::min(oldest.end, oldest.begin + RefillSize)};
+      for (auto i{oldest.begin}; i < end; ++i) {
+        T element;
+        std::memcpy(&element, slots + i * sizeof(T), sizeof(T));
+        m_memory.push_back(element);
+      }
+      m_spilledCount -= end - oldest.begin;
+      oldest.begin = end;
+      if (oldest.begin == oldest.end)
+        m_spilled.pop_front();
+    }
+    return !m_memory.empty();
+  }
+
+  void popFront(T &value) {
+    value = m_memory.front();
+    m_memory.pop_front();
+  }
+
+  std::filesystem::path m_directory;
+  std::size_t m_memoryLimit;
+  std::deque<T> m_memory;
+  std::deque<Segment> m_spilled;
+  std::size_t m_spilledCount{};
+  mutable std::mutex m_mutex;
+  WaitPolicy m_notEmpty;
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+
+// Minimal fire-and-forget coroutine type for consumers that co_await asyncPop.
+// The coroutine runs as soon as it is called, up to its first suspension, and
+// frees its own frame when it returns, so it can finish on whichever thread
+// resumed it without anyone having to join it. A coroutine that never returns
+// keeps its frame. An exception escaping the coroutine terminates the program,
+// as with FreshThreadPool tasks.
+struct FreshTask {
+  struct promise_type {
+    FreshTask get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "freshdeque.h"
+#include "freshnodepool.h"
+#include "freshqueue.h"
+
+// Fixed-size executor for fine-grained tasks. Each worker owns a
+// WorkStealingFreshDeque: tasks submitted from a worker go to the bottom of its
+// own deque and are run newest first, while idle workers steal the oldest
+// tasks from the others. Tasks submitted from outside the pool go through a
+// ConcurrentFreshQueue that every worker checks before stealing. Task objects
+// come from a FreshNodePool, so a steady fork/join workload does not reach the
+// global allocator. An exception escaping a task terminates the program, as
+// with std::thread. The destructor runs every queued task before joining.
+class FreshThreadPool {
+public:
+  FreshThreadPool()
+      : FreshThreadPool{std::max(1u, std::thread::hardware_concurrency())} {}
+  explicit FreshThreadPool(std::size_t workerCount);
+  FreshThreadPool(const FreshThreadPool &) = delete;
+  FreshThreadPool(FreshThreadPool &&) noexcept = delete;
+  FreshThreadPool &operator=(const FreshThreadPool &) = delete;
+  FreshThreadPool &operator=(FreshThreadPool &&) noexcept = delete;
+  virtual ~FreshThreadPool();
+
+  std::size_t workerCount() const noexcept { return m_workerCount; }
+
+  template <typename F> void submit(F &&function) {
+    using Bound = BoundTask<std::decay_t<F>>;
+    std::pmr::polymorphic_allocator<> allocator{&m_taskPool};
+    Task *task{allocator.new_object<Bound>(std::forward<F>(function))};
+    enqueue(task);
+  }
+
+  // Runs queued tasks on the calling thread until done() holds. Use it to wait
+  // for tasks forked from inside another task without blocking a worker.
+  template <typename Predicate> void runUntil(Predicate done) {
+    while (!done()) {
+      if (!runOne())
+        std::this_thread::yield();
+    }
+  }
+
+private:
+  using Idle = SpinAtomicIdle<128>;
+
+  struct Task {
+    void (*execute)(Task *, std::pmr::memory_resource *) noexcept;
+  };
+
+  template <typename F> struct BoundTask : Task {
+    explicit BoundTask(F function)
+        : Task{&BoundTask::run}, m_function{std::move(function)} {}
+
+    static void run(Task *task, std::pmr::memory_resource *resource) noexcept {
+      auto bound{static_cast<BoundTask *>(task)};
+      bound->m_function();
+      std::pmr::polymorphic_allocator<>{resource}.delete_object(bound);
+    }
+
+    F m_function;
+  };
+
+  struct alignas(CacheLineSize) Worker {
+    WorkStealingFreshDeque<Task *> deque;
+    std::thread thread;
+  };
+
+  void enqueue(Task *task);
+  bool runOne();
+  Task *findTask();
+  void execute(Task *task) noexcept;
+  void wakeOne() noexcept;
+  void work(std::size_t index);
+
+  std::size_t m_workerCount;
+  FreshNodePool m_taskPool;
+  ConcurrentFreshQueue<Task *> m_injected;
+  std::unique_ptr<Worker[]> m_workers;
+  std::atomic<bool> m_stopping{};
+  alignas(CacheLineSize) std::atomic<std::size_t> m_sleepers{};
+  alignas(CacheLineSize) std::atomic<std::uint32_t> m_epoch{};
+};
@@ -1,2 +1,11 @@
 #pragma once
+#include "freshbytering.h"
+#include "freshdeque.h"
+#include "freshhazard.h"
+#include "freshnodepool.h"
+#include "freshpipeline.h"
 #include "freshqueue.h"
+#include "freshsharedmemory.h"
+#include "freshspillingqueue.h"
+#include "freshtask.h"
+#include "freshthreadpool.h"
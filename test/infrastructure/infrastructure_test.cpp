@@ -1,6 +1,7 @@
 #include "infrastructure/infrastructure.h"
 #include "gtest/gtest.h"
-#include <boost/lockfree/queue.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // Tests for ThreadSafeFreshQueue
 
@@ -193,6 +194,281 @@ TEST(ThreadSafeFreshQueueOfInts, manyWaitAndPopByPointerThenPush) {
   pushThread.join();
 }
 
+TEST(ThreadSafeFreshQueueOfInts, pushRangeSize) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  std::vector<int> values{1, 2, 3, 4, 5};
+  freshQueue.pushRange(values.begin(), values.end());
+  ASSERT_EQ(freshQueue.size(), 5);
+}
+
+TEST(ThreadSafeFreshQueueOfInts, pushSpanAndTryPopBulk) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  std::vector<int> values{1, 2, 3, 4, 5};
+  freshQueue.push(std::span<const int>{values});
+  std::vector<int> result{};
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(result), 3), 3);
+  ASSERT_EQ(result, (std::vector<int>{1, 2, 3}));
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(result), 10), 2);
+  ASSERT_EQ(result, values);
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ThreadSafeFreshQueueOfInts, initiallyEmptyTryPopBulk) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  std::vector<int> result{};
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(result), 10), 0);
+}
+
+TEST(ThreadSafeFreshQueueOfInts, waitAndPopBulkThenPushRange) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  std::vector<int> values{1, 2, 3, 4, 5};
+  std::vector<int> result{};
+  std::thread popThread{[&] {
+    while (result.size() < values.size()) {
+      freshQueue.waitAndPopBulk(std::back_inserter(result), values.size());
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.pushRange(values.begin(), values.end());
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(result, values);
+}
+
+
+TEST(ThreadSafeFreshQueueOfInts, boundedTryPushFailsWhenFull) {
+  ThreadSafeFreshQueue<int> freshQueue{2};
+  ASSERT_TRUE(freshQueue.tryPush(1));
+  ASSERT_TRUE(freshQueue.tryPush(2));
+  ASSERT_FALSE(freshQueue.tryPush(3));
+  int value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_TRUE(freshQueue.tryPush(3));
+}
+
+TEST(ThreadSafeFreshQueueOfInts, boundedInvalidWatermarkThrows) {
+  ASSERT_THROW((ThreadSafeFreshQueue<int>{4, 4}), std::invalid_argument);
+  ASSERT_THROW((ThreadSafeFreshQueue<int>{0}), std::invalid_argument);
+}
+
+TEST(ThreadSafeFreshQueueOfInts, boundedWaitAndPushResumesAtLowWatermark) {
+  ThreadSafeFreshQueue<int> freshQueue{4, 1};
+  for (auto &&i : std::views::iota(0, 4)) {
+    freshQueue.push(i);
+  }
+  std::atomic<bool> pushed{};
+  std::thread pushThread{[&] {
+    freshQueue.waitAndPush(4);
+    pushed = true;
+  }};
+  using namespace std::chrono;
+  std::this_thread::sleep_for(10ms);
+  int value{};
+  freshQueue.waitAndPop(value);
+  freshQueue.waitAndPop(value);
+  std::this_thread::sleep_for(10ms);
+  ASSERT_FALSE(pushed);
+  freshQueue.waitAndPop(value);
+  pushThread.join();
+  ASSERT_TRUE(pushed);
+  freshQueue.waitAndPop(value);
+  ASSERT_EQ(value, 3);
+  freshQueue.waitAndPop(value);
+  ASSERT_EQ(value, 4);
+}
+
+TEST(ThreadSafeFreshQueueOfInts, boundedPushRangeKeepsOrder) {
+  using namespace std::views;
+  ThreadSafeFreshQueue<int> freshQueue{4};
+  auto numbers{iota(0, 100)};
+  std::vector<int> values(numbers.begin(), numbers.end());
+  std::thread pushThread{
+      [&] { freshQueue.pushRange(values.begin(), values.end()); }};
+  std::vector<int> result{};
+  int value{};
+  for (auto &&_ : iota(0, 100)) {
+    freshQueue.waitAndPop(value);
+    result.push_back(value);
+  }
+  pushThread.join();
+  ASSERT_EQ(result, values);
+}
+
+TEST(ThreadSafeFreshQueueOfInts, boundedManyProducersAndConsumers) {
+  using namespace std::views;
+  ThreadSafeFreshQueue<int> freshQueue{8};
+  std::atomic<int> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 4)) {
+    threads.emplace_back([&] {
+      for (auto &&i : iota(1, 1'001)) {
+        freshQueue.push(i);
+      }
+    });
+    threads.emplace_back([&] {
+      int value{};
+      for (auto &&_ : iota(0, 1'000)) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 4 * 500'500);
+}
+
+TEST(ThreadSafeFreshQueueOfSharedInts, pushAndPopByPointer) {
+  ThreadSafeFreshQueue<int, SharedStorage> freshQueue{};
+  freshQueue.push(42);
+  auto result{freshQueue.pop()};
+  ASSERT_EQ(*result, 42);
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ThreadSafeFreshQueueOfSharedInts, pushAndTryPopByValue) {
+  ThreadSafeFreshQueue<int, SharedStorage> freshQueue{};
+  freshQueue.push(42);
+  int value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_EQ(value, 42);
+}
+
+TEST(ThreadSafeFreshQueueOfSharedInts, pushRangeAndTryPopBulk) {
+  ThreadSafeFreshQueue<int, SharedStorage> freshQueue{};
+  std::vector<int> values{1, 2, 3, 4, 5};
+  freshQueue.pushRange(values.begin(), values.end());
+  std::vector<int> result{};
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(result), 10), 5);
+  ASSERT_EQ(result, values);
+}
+
+TEST(ThreadSafeFreshQueueOfStrings, popByPointerMovesInlineElement) {
+  ThreadSafeFreshQueue<std::string> freshQueue{};
+  freshQueue.push(std::string(64, 'x'));
+  freshQueue.push("second");
+  auto result{freshQueue.pop()};
+  ASSERT_EQ(*result, std::string(64, 'x'));
+  std::string value{};
+  freshQueue.pop(value);
+  ASSERT_EQ(value, "second");
+}
+
+TEST(ThreadSafeFreshQueueOfBusySpinInts, manyWaitAndPopByValueThenPush) {
+  ThreadSafeFreshQueue<int, InlineStorage, BusySpinWait> freshQueue{};
+  int value{};
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    using namespace std::views;
+    std::this_thread::sleep_for(10ms);
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
+}
+
+TEST(ThreadSafeFreshQueueOfSpinYieldInts, manyWaitAndPopByValueThenPush) {
+  ThreadSafeFreshQueue<int, InlineStorage, SpinYieldWait<>> freshQueue{};
+  int value{};
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    using namespace std::views;
+    std::this_thread::sleep_for(10ms);
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
+}
+
+TEST(ThreadSafeFreshQueueOfSpinAtomicInts, manyWaitAndPopByValueThenPush) {
+  ThreadSafeFreshQueue<int, InlineStorage, SpinAtomicWait<>> freshQueue{};
+  int value{};
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    using namespace std::views;
+    std::this_thread::sleep_for(10ms);
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
+}
+
+TEST(ThreadSafeFreshQueueOfSpinAtomicInts, manyConsumersWakeOnPushRange) {
+  using namespace std::views;
+  ThreadSafeFreshQueue<int, InlineStorage, SpinAtomicWait<>> freshQueue{};
+  std::atomic<int> sum{};
+  std::vector<std::thread> popThreads{};
+  for (auto &&t : iota(0, 4)) {
+    popThreads.emplace_back([&] {
+      int value{};
+      freshQueue.waitAndPop(value);
+      sum += value;
+    });
+  }
+  std::vector<int> values{1, 2, 3, 4};
+  freshQueue.pushRange(values.begin(), values.end());
+  for (auto &&thread : popThreads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 10);
+}
+
+TEST(ThreadSafeFreshQueueOfSpinYieldInts, boundedManyProducersAndConsumers) {
+  using namespace std::views;
+  ThreadSafeFreshQueue<int, InlineStorage, SpinYieldWait<>> freshQueue{8};
+  std::atomic<int> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 4)) {
+    threads.emplace_back([&] {
+      for (auto &&i : iota(1, 1'001)) {
+        freshQueue.push(i);
+      }
+    });
+    threads.emplace_back([&] {
+      int value{};
+      for (auto &&_ : iota(0, 1'000)) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 4 * 500'500);
+}
+
 // Tests for ConcurrentFreshQueue
 
 TEST(ConcurrentFreshQueueOfInts, initiallyEmptyEmpty) {
@@ -328,56 +604,197 @@ TEST(ConcurrentFreshQueueOfInts, manyWaitAndPopByPointerThenPush) {
   pushThread.join();
 }
 
-// Tests for Boost::lockfree::queue
+TEST(ConcurrentFreshQueueOfInts, pushRangeEmpty) {
+  ConcurrentFreshQueue<int> freshQueue{};
+  std::vector<int> values{};
+  freshQueue.pushRange(values.begin(), values.end());
+  ASSERT_TRUE(freshQueue.empty());
+}
 
-TEST(LockFreeFreshQueueOfInts, initiallyEmptyEmpty) {
-  boost::lockfree::queue<int> freshQueue{10};
+TEST(ConcurrentFreshQueueOfInts, pushSpanAndTryPopBulk) {
+  ConcurrentFreshQueue<int> freshQueue{};
+  std::vector<int> values{1, 2, 3, 4, 5};
+  freshQueue.push(std::span<const int>{values});
+  std::vector<int> result{};
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(result), 3), 3);
+  ASSERT_EQ(result, (std::vector<int>{1, 2, 3}));
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(result), 10), 2);
+  ASSERT_EQ(result, values);
   ASSERT_TRUE(freshQueue.empty());
 }
 
-TEST(LockFreeFreshQueueOfInts, onePushEmpty) {
-  boost::lockfree::queue<int> freshQueue{10};
-  freshQueue.push(42);
-  ASSERT_FALSE(freshQueue.empty());
+TEST(ConcurrentFreshQueueOfInts, pushRangeAfterPushKeepsOrder) {
+  ConcurrentFreshQueue<int> freshQueue{};
+  std::vector<int> values{2, 3, 4};
+  freshQueue.push(1);
+  freshQueue.pushRange(values.begin(), values.end());
+  freshQueue.push(5);
+  std::vector<int> result{};
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(result), 10), 5);
+  ASSERT_EQ(result, (std::vector<int>{1, 2, 3, 4, 5}));
 }
 
-TEST(LockFreeFreshQueueOfInts, manyPushEmpty) {
-  using namespace std::views;
-  boost::lockfree::queue<int> freshQueue{10};
-  for (auto &&i : iota(0, 100)) {
+TEST(ConcurrentFreshQueueOfInts, waitAndPopBulkThenPushRange) {
+  ConcurrentFreshQueue<int> freshQueue{};
+  std::vector<int> values{1, 2, 3, 4, 5};
+  std::vector<int> result{};
+  std::thread popThread{[&] {
+    while (result.size() < values.size()) {
+      freshQueue.waitAndPopBulk(std::back_inserter(result), values.size());
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.pushRange(values.begin(), values.end());
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(result, values);
+}
+
+
+TEST(ConcurrentFreshQueueOfInts, boundedTryPushFailsWhenFull) {
+  ConcurrentFreshQueue<int> freshQueue{2};
+  ASSERT_TRUE(freshQueue.tryPush(1));
+  ASSERT_TRUE(freshQueue.tryPush(2));
+  ASSERT_FALSE(freshQueue.tryPush(3));
+  int value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_TRUE(freshQueue.tryPush(3));
+}
+
+TEST(ConcurrentFreshQueueOfInts, boundedInvalidWatermarkThrows) {
+  ASSERT_THROW((ConcurrentFreshQueue<int>{4, 4}), std::invalid_argument);
+  ASSERT_THROW((ConcurrentFreshQueue<int>{0}), std::invalid_argument);
+}
+
+TEST(ConcurrentFreshQueueOfInts, boundedWaitAndPushResumesAtLowWatermark) {
+  ConcurrentFreshQueue<int> freshQueue{4, 1};
+  for (auto &&i : std::views::iota(0, 4)) {
     freshQueue.push(i);
   }
-  ASSERT_FALSE(freshQueue.empty());
+  std::atomic<bool> pushed{};
+  std::thread pushThread{[&] {
+    freshQueue.waitAndPush(4);
+    pushed = true;
+  }};
+  using namespace std::chrono;
+  std::this_thread::sleep_for(10ms);
+  int value{};
+  freshQueue.waitAndPop(value);
+  freshQueue.waitAndPop(value);
+  std::this_thread::sleep_for(10ms);
+  ASSERT_FALSE(pushed);
+  freshQueue.waitAndPop(value);
+  pushThread.join();
+  ASSERT_TRUE(pushed);
+  freshQueue.waitAndPop(value);
+  ASSERT_EQ(value, 3);
+  freshQueue.waitAndPop(value);
+  ASSERT_EQ(value, 4);
 }
 
-TEST(LockFreeFreshQueueOfInts, initiallyEmptyPop) {
-  boost::lockfree::queue<int> freshQueue{10};
+TEST(ConcurrentFreshQueueOfInts, boundedPushRangeKeepsOrder) {
+  using namespace std::views;
+  ConcurrentFreshQueue<int> freshQueue{4};
+  auto numbers{iota(0, 100)};
+  std::vector<int> values(numbers.begin(), numbers.end());
+  std::thread pushThread{
+      [&] { freshQueue.pushRange(values.begin(), values.end()); }};
+  std::vector<int> result{};
   int value{};
-  ASSERT_FALSE(freshQueue.pop(value));
+  for (auto &&_ : iota(0, 100)) {
+    freshQueue.waitAndPop(value);
+    result.push_back(value);
+  }
+  pushThread.join();
+  ASSERT_EQ(result, values);
 }
 
-TEST(LockFreeFreshQueueOfInts, pushAndPop) {
-  boost::lockfree::queue<int> freshQueue{10};
-  freshQueue.push(42);
+TEST(ConcurrentFreshQueueOfInts, boundedManyProducersAndConsumers) {
+  using namespace std::views;
+  ConcurrentFreshQueue<int> freshQueue{8};
+  std::atomic<int> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 4)) {
+    threads.emplace_back([&] {
+      for (auto &&i : iota(1, 1'001)) {
+        freshQueue.push(i);
+      }
+    });
+    threads.emplace_back([&] {
+      int value{};
+      for (auto &&_ : iota(0, 1'000)) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 4 * 500'500);
+}
+
+TEST(ConcurrentFreshQueueOfBusySpinInts, manyWaitAndPopByValueThenPush) {
+  ConcurrentFreshQueue<int, std::allocator<int>, BusySpinWait> freshQueue{};
   int value{};
-  ASSERT_TRUE(freshQueue.pop(value));
-  ASSERT_EQ(value, 42);
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    using namespace std::views;
+    std::this_thread::sleep_for(10ms);
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
 }
 
-TEST(LockFreeFreshQueueOfInts, manyWaitAndPopThenPush) {
-  boost::lockfree::queue<int> freshQueue{10};
+TEST(ConcurrentFreshQueueOfSpinYieldInts, manyWaitAndPopByValueThenPush) {
+  ConcurrentFreshQueue<int, std::allocator<int>, SpinYieldWait<>> freshQueue{};
+  int value{};
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    using namespace std::views;
+    std::this_thread::sleep_for(10ms);
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
+}
+
+TEST(ConcurrentFreshQueueOfSpinAtomicInts, manyWaitAndPopByValueThenPush) {
+  ConcurrentFreshQueue<int, std::allocator<int>, SpinAtomicWait<>> freshQueue{};
   int value{};
   std::thread popThread{[&] {
     using namespace std::views;
     for (auto &&i : iota(0, 1'000)) {
-      while (!freshQueue.pop(value))
-        ;
+      freshQueue.waitAndPop(value);
       ASSERT_EQ(value, i);
     }
   }};
   std::thread pushThread{[&] {
     using namespace std::chrono;
     using namespace std::views;
+    std::this_thread::sleep_for(10ms);
     for (auto &&i : iota(0, 1'000)) {
       freshQueue.push(i);
     }
@@ -385,3 +802,2167 @@ TEST(LockFreeFreshQueueOfInts, manyWaitAndPopThenPush) {
   popThread.join();
   pushThread.join();
 }
+
+TEST(ConcurrentFreshQueueOfSpinAtomicInts, boundedManyProducersAndConsumers) {
+  using namespace std::views;
+  ConcurrentFreshQueue<int, std::allocator<int>, SpinAtomicWait<>> freshQueue{
+      8};
+  std::atomic<int> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 4)) {
+    threads.emplace_back([&] {
+      for (auto &&i : iota(1, 1'001)) {
+        freshQueue.push(i);
+      }
+    });
+    threads.emplace_back([&] {
+      int value{};
+      for (auto &&_ : iota(0, 1'000)) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 4 * 500'500);
+}
+
+TEST(ConcurrentFreshQueueOfInts, manyConsumersWakeOnPushRange) {
+  using namespace std::views;
+  ConcurrentFreshQueue<int> freshQueue{};
+  std::atomic<int> sum{};
+  std::vector<std::thread> popThreads{};
+  for (auto &&t : iota(0, 4)) {
+    popThreads.emplace_back([&] {
+      int value{};
+      freshQueue.waitAndPop(value);
+      sum += value;
+    });
+  }
+  std::vector<int> values{1, 2, 3, 4};
+  freshQueue.pushRange(values.begin(), values.end());
+  for (auto &&thread : popThreads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 10);
+}
+
+class CountingResource : public std::pmr::memory_resource {
+public:
+  std::size_t allocations() const noexcept { return m_allocations; }
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++m_allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *pointer, std::size_t bytes,
+                     std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+  }
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  std::atomic<std::size_t> m_allocations{};
+};
+
+TEST(ConcurrentFreshQueueOfPooledInts, pushAndTryPopByValue) {
+  FreshNodePool pool{};
+  ConcurrentFreshQueue<int, std::pmr::polymorphic_allocator<int>> freshQueue{
+      &pool};
+  freshQueue.push(42);
+  int value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_EQ(value, 42);
+}
+
+TEST(ConcurrentFreshQueueOfPooledInts, pushAndWaitAndPopByPointer) {
+  FreshNodePool pool{};
+  ConcurrentFreshQueue<int, std::pmr::polymorphic_allocator<int>> freshQueue{
+      &pool};
+  freshQueue.push(42);
+  auto result{freshQueue.waitAndPop()};
+  ASSERT_EQ(*result, 42);
+}
+
+TEST(ConcurrentFreshQueueOfPooledInts, steadyStateDoesNotAllocateUpstream) {
+  using namespace std::views;
+  CountingResource upstream{};
+  FreshNodePool pool{&upstream};
+  ConcurrentFreshQueue<int, std::pmr::polymorphic_allocator<int>> freshQueue{
+      &pool};
+  int value{};
+  freshQueue.push(0);
+  freshQueue.tryPop(value);
+  auto warmedUp{upstream.allocations()};
+  for (auto &&i : iota(0, 100'000)) {
+    freshQueue.push(i);
+    freshQueue.tryPop(value);
+  }
+  ASSERT_EQ(upstream.allocations(), warmedUp);
+}
+
+TEST(ConcurrentFreshQueueOfPooledInts, manyWaitAndPopByValueThenPush) {
+  FreshNodePool pool{};
+  ConcurrentFreshQueue<int, std::pmr::polymorphic_allocator<int>> freshQueue{
+      &pool};
+  int value{};
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 10'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 10'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
+}
+
+// Tests for ConcurrentFreshQueue with QueueStats
+
+using CountedConcurrentFreshQueue =
+    ConcurrentFreshQueue<int, std::allocator<int>, CondVarWait, QueueStats>;
+
+TEST(ConcurrentFreshQueueOfCountedInts, initiallyZeroStats) {
+  CountedConcurrentFreshQueue freshQueue{};
+  auto stats{freshQueue.stats()};
+  ASSERT_EQ(stats.depth, 0);
+  ASSERT_EQ(stats.highWaterDepth, 0);
+  ASSERT_EQ(stats.pushes, 0);
+  ASSERT_EQ(stats.pops, 0);
+  ASSERT_EQ(stats.waits, 0);
+}
+
+TEST(ConcurrentFreshQueueOfCountedInts, countsDepthAndHighWater) {
+  using namespace std::views;
+  CountedConcurrentFreshQueue freshQueue{};
+  for (auto &&i : iota(0, 10)) {
+    freshQueue.push(i);
+  }
+  int value{};
+  for (auto &&i : iota(0, 4)) {
+    freshQueue.tryPop(value);
+    ASSERT_EQ(value, i);
+  }
+  auto stats{freshQueue.stats()};
+  ASSERT_EQ(stats.depth, 6);
+  ASSERT_EQ(stats.highWaterDepth, 10);
+  ASSERT_EQ(stats.pushes, 10);
+  ASSERT_EQ(stats.pops, 4);
+}
+
+TEST(ConcurrentFreshQueueOfCountedInts, countsRangesAndBulkPops) {
+  CountedConcurrentFreshQueue freshQueue{};
+  std::vector<int> values{1, 2, 3, 4, 5};
+  freshQueue.push(std::span<const int>{values});
+  std::vector<int> popped{};
+  freshQueue.tryPopBulk(std::back_inserter(popped), 3);
+  auto stats{freshQueue.stats()};
+  ASSERT_EQ(stats.pushes, 5);
+  ASSERT_EQ(stats.pops, 3);
+  ASSERT_EQ(stats.depth, 2);
+}
+
+TEST(ConcurrentFreshQueueOfCountedInts, recordsConsumerWait) {
+  CountedConcurrentFreshQueue freshQueue{};
+  int value{};
+  std::thread popThread{[&] { freshQueue.waitAndPop(value); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  freshQueue.push(42);
+  popThread.join();
+  auto stats{freshQueue.stats()};
+  ASSERT_EQ(value, 42);
+  ASSERT_EQ(stats.waits, 1);
+  ASSERT_GT(stats.maxWait, std::chrono::nanoseconds{0});
+  ASSERT_EQ(stats.totalWait, stats.maxWait);
+}
+
+TEST(ConcurrentFreshQueueOfCountedInts, manyProducersAndConsumersBalance) {
+  CountedConcurrentFreshQueue freshQueue{};
+  std::vector<std::thread> threads{};
+  for (int i{}; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j{}; j < 1'000; ++j) {
+        freshQueue.push(j);
+      }
+    });
+    threads.emplace_back([&] {
+      int value{};
+      for (int j{}; j < 1'000; ++j) {
+        freshQueue.waitAndPop(value);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto stats{freshQueue.stats()};
+  ASSERT_EQ(stats.pushes, 4'000);
+  ASSERT_EQ(stats.pops, 4'000);
+  ASSERT_EQ(stats.depth, 0);
+  ASSERT_LE(stats.highWaterDepth, 4'000);
+}
+
+// Tests for SegmentedFreshQueue
+
+TEST(SegmentedFreshQueueOfInts, initiallyEmpty) {
+  SegmentedFreshQueue<int, 4> freshQueue{};
+  int value{};
+  ASSERT_TRUE(freshQueue.empty());
+  ASSERT_FALSE(freshQueue.tryPop(value));
+}
+
+TEST(SegmentedFreshQueueOfInts, manyPushKeepsOrderAcrossSegments) {
+  using namespace std::views;
+  SegmentedFreshQueue<int, 4> freshQueue{};
+  for (auto &&i : iota(0, 100)) {
+    freshQueue.push(i);
+  }
+  int value{};
+  for (auto &&i : iota(0, 100)) {
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(SegmentedFreshQueueOfInts, interleavedPushAndPopReusesSegments) {
+  SegmentedFreshQueue<int, 4> freshQueue{};
+  int value{};
+  for (int i{}; i < 1'000; ++i) {
+    freshQueue.push(i);
+    freshQueue.push(i);
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(SegmentedFreshQueueOfInts, pushRangeAndPopBulkAcrossSegments) {
+  SegmentedFreshQueue<int, 4> freshQueue{};
+  auto numbers{std::views::iota(0, 30)};
+  std::vector<int> values(numbers.begin(), numbers.end());
+  freshQueue.push(std::span<const int>{values});
+  std::vector<int> popped{};
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(popped), 11), 11);
+  ASSERT_EQ(freshQueue.tryPopBulk(std::back_inserter(popped), 100), 19);
+  ASSERT_EQ(popped, values);
+}
+
+TEST(SegmentedFreshQueueOfInts, destroysUnpoppedElements) {
+  auto element{std::make_shared<int>(42)};
+  {
+    SegmentedFreshQueue<std::shared_ptr<int>, 4> freshQueue{};
+    for (int i{}; i < 10; ++i) {
+      freshQueue.push(element);
+    }
+    std::shared_ptr<int> value{};
+    freshQueue.tryPop(value);
+    ASSERT_EQ(element.use_count(), 11);
+  }
+  ASSERT_EQ(element.use_count(), 1);
+}
+
+TEST(SegmentedFreshQueueOfInts, waitAndPopByValueThenPush) {
+  SegmentedFreshQueue<int, 4> freshQueue{};
+  int value{};
+  std::thread popThread{[&] { freshQueue.waitAndPop(value); }};
+  freshQueue.push(42);
+  popThread.join();
+  ASSERT_EQ(value, 42);
+}
+
+TEST(SegmentedFreshQueueOfInts, manyProducersAndConsumers) {
+  SegmentedFreshQueue<int, 8> freshQueue{};
+  std::atomic<long> sum{};
+  std::vector<std::thread> threads{};
+  for (int i{}; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j{1}; j <= 10'000; ++j) {
+        freshQueue.push(j);
+      }
+    });
+    threads.emplace_back([&] {
+      int value{};
+      for (int j{}; j < 10'000; ++j) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 4L * 10'000 * 10'001 / 2);
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(SegmentedFreshQueueOfVectors, throwingEmplaceLeavesNoElement) {
+  SegmentedFreshQueue<std::vector<int>, 4> freshQueue{};
+  for (int i{}; i < 10; ++i) {
+    freshQueue.push(std::vector{i});
+    ASSERT_THROW(
+        freshQueue.emplace(std::numeric_limits<std::size_t>::max(), 0),
+        std::length_error);
+  }
+  std::vector<int> value{};
+  for (int i{}; i < 10; ++i) {
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_EQ(value, std::vector{i});
+  }
+  ASSERT_FALSE(freshQueue.tryPop(value));
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+namespace {
+// Throws when copied from a negative value or moved over from a 3.
+struct Fragile {
+  explicit Fragile(int number = 0) : value{number} {}
+  Fragile(const Fragile &other) : value{other.value} {
+    if (value < 0)
+      throw std::runtime_error{"negative"};
+  }
+  Fragile(Fragile &&) noexcept = default;
+  Fragile &operator=(Fragile &&other) {
+    if (other.value == 3)
+      throw std::runtime_error{"three"};
+    value = other.value;
+    return *this;
+  }
+  ~Fragile() = default;
+
+  int value;
+};
+} // namespace
+
+TEST(SegmentedFreshQueueOfFragiles, throwingCopyKeepsTheStartOfARange) {
+  SegmentedFreshQueue<Fragile, 4> freshQueue{};
+  std::vector<Fragile> values{};
+  for (auto number : {0, 1, 2, -1, 4, 5}) {
+    values.emplace_back(number);
+  }
+  ASSERT_THROW(freshQueue.pushRange(values.begin(), values.end()),
+               std::runtime_error);
+  freshQueue.push(Fragile{6});
+  std::vector<Fragile> popped(8);
+  ASSERT_EQ(freshQueue.tryPopBulk(popped.begin(), popped.size()), 4);
+  ASSERT_EQ(popped[0].value, 0);
+  ASSERT_EQ(popped[2].value, 2);
+  ASSERT_EQ(popped[3].value, 6);
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(SegmentedFreshQueueOfFragiles, throwingMoveDropsTheRestOfTheRun) {
+  SegmentedFreshQueue<Fragile, 8> freshQueue{};
+  for (int i{}; i < 6; ++i) {
+    freshQueue.push(Fragile{i});
+  }
+  std::vector<Fragile> popped(6);
+  ASSERT_THROW(freshQueue.tryPopBulk(popped.begin(), popped.size()),
+               std::runtime_error);
+  ASSERT_EQ(popped[2].value, 2);
+  ASSERT_TRUE(freshQueue.empty());
+  freshQueue.push(Fragile{7});
+  Fragile value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_EQ(value.value, 7);
+}
+
+// Tests for ShardedFreshQueue
+
+TEST(ShardedFreshQueueOfInts, zeroLanesThrows) {
+  ASSERT_THROW(ShardedFreshQueue<int>{0}, std::invalid_argument);
+}
+
+TEST(ShardedFreshQueueOfInts, initiallyEmptyEmpty) {
+  ShardedFreshQueue<int> freshQueue{4};
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ShardedFreshQueueOfInts, initiallyEmptyTryPopByValue) {
+  ShardedFreshQueue<int> freshQueue{4};
+  int value{};
+  ASSERT_FALSE(freshQueue.tryPop(value));
+}
+
+TEST(ShardedFreshQueueOfInts, initiallyEmptyTryPopByPointer) {
+  ShardedFreshQueue<int> freshQueue{4};
+  ASSERT_EQ(freshQueue.tryPop(), nullptr);
+}
+
+TEST(ShardedFreshQueueOfInts, onePushEmpty) {
+  ShardedFreshQueue<int> freshQueue{4};
+  freshQueue.push(42);
+  ASSERT_FALSE(freshQueue.empty());
+}
+
+TEST(ShardedFreshQueueOfInts, manyPushKeepsOrderOfOneThread) {
+  using namespace std::views;
+  ShardedFreshQueue<int> freshQueue{4};
+  for (auto &&i : iota(0, 100)) {
+    freshQueue.push(i);
+  }
+  int value{};
+  for (auto &&i : iota(0, 100)) {
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ShardedFreshQueueOfInts, tryPopStealsFromOtherLanes) {
+  using namespace std::views;
+  ShardedFreshQueue<int> freshQueue{4};
+  std::vector<std::thread> pushThreads{};
+  for (auto &&t : iota(0, 4)) {
+    pushThreads.emplace_back([&freshQueue, t] { freshQueue.push(t); });
+  }
+  for (auto &&thread : pushThreads) {
+    thread.join();
+  }
+  std::vector<int> result{};
+  while (auto value{freshQueue.tryPop()}) {
+    result.push_back(*value);
+  }
+  std::ranges::sort(result);
+  ASSERT_EQ(result, (std::vector<int>{0, 1, 2, 3}));
+}
+
+TEST(ShardedFreshQueueOfInts, waitAndPopByValueThenPush) {
+  ShardedFreshQueue<int> freshQueue{4};
+  int value{};
+  std::thread popThread{[&] { freshQueue.waitAndPop(value); }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.push(42);
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(value, 42);
+}
+
+TEST(ShardedFreshQueueOfInts, waitAndPopByPointerThenPush) {
+  ShardedFreshQueue<int> freshQueue{4};
+  std::shared_ptr<int> value{};
+  std::thread popThread{[&] { value = freshQueue.waitAndPop(); }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.push(42);
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(*value, 42);
+}
+
+TEST(ShardedFreshQueueOfInts, manyProducersAndConsumers) {
+  using namespace std::views;
+  ShardedFreshQueue<int> freshQueue{3};
+  std::atomic<int> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 4)) {
+    threads.emplace_back([&] {
+      int value{};
+      for (auto &&_ : iota(0, 1'000)) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+    threads.emplace_back([&] {
+      for (auto &&i : iota(1, 1'001)) {
+        freshQueue.push(i);
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 4 * 500'500);
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ShardedFreshQueueOfBusySpinInts, manyProducersAndConsumers) {
+  using namespace std::views;
+  ShardedFreshQueue<int, BusySpinIdle> freshQueue{2};
+  std::atomic<int> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 2)) {
+    threads.emplace_back([&] {
+      int value{};
+      for (auto &&_ : iota(0, 1'000)) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+    threads.emplace_back([&] {
+      for (auto &&i : iota(1, 1'001)) {
+        freshQueue.push(i);
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 2 * 500'500);
+}
+
+// Tests for PriorityFreshQueue
+
+TEST(PriorityFreshQueueOfInts, initiallyEmptyTryPop) {
+  PriorityFreshQueue<int> freshQueue{};
+  int value{};
+  ASSERT_TRUE(freshQueue.empty());
+  ASSERT_FALSE(freshQueue.tryPop(value));
+  ASSERT_EQ(freshQueue.tryPop(), nullptr);
+}
+
+TEST(PriorityFreshQueueOfInts, pushToMissingLevelThrows) {
+  PriorityFreshQueue<int, 4> freshQueue{};
+  ASSERT_THROW(freshQueue.push(42, 4), std::out_of_range);
+}
+
+TEST(PriorityFreshQueueOfInts, urgentLevelsOvertake) {
+  PriorityFreshQueue<int> freshQueue{};
+  freshQueue.push(7, 7);
+  freshQueue.push(3, 3);
+  freshQueue.push(0, 0);
+  freshQueue.push(5, 5);
+  int value{};
+  for (auto &&expected : {0, 3, 5, 7}) {
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_EQ(value, expected);
+  }
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(PriorityFreshQueueOfInts, sameLevelKeepsOrder) {
+  using namespace std::views;
+  PriorityFreshQueue<int, 64> freshQueue{};
+  for (auto &&i : iota(0, 10)) {
+    freshQueue.push(i, 63);
+  }
+  freshQueue.push(-1, 0);
+  ASSERT_EQ(*freshQueue.tryPop(), -1);
+  for (auto &&i : iota(0, 10)) {
+    ASSERT_EQ(*freshQueue.tryPop(), i);
+  }
+}
+
+TEST(PriorityFreshQueueOfInts, waitAndPopByValueThenPush) {
+  PriorityFreshQueue<int> freshQueue{};
+  int value{};
+  std::thread popThread{[&] { freshQueue.waitAndPop(value); }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.push(42, 6);
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(value, 42);
+}
+
+TEST(PriorityFreshQueueOfInts, manyProducersAndConsumers) {
+  using namespace std::views;
+  PriorityFreshQueue<int, 4> freshQueue{};
+  std::atomic<int> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 4)) {
+    threads.emplace_back([&] {
+      std::shared_ptr<int> value{};
+      for (auto &&_ : iota(0, 1'000)) {
+        value = freshQueue.waitAndPop();
+        sum += *value;
+      }
+    });
+    threads.emplace_back([&] {
+      for (auto &&i : iota(1, 1'001)) {
+        freshQueue.push(i, static_cast<std::size_t>(i % 4));
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 4 * 500'500);
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+// Tests for FreshNodePool
+
+TEST(FreshNodePool, reusesReleasedBlock) {
+  FreshNodePool pool{};
+  auto first{pool.allocate(48)};
+  pool.deallocate(first, 48);
+  auto second{pool.allocate(48)};
+  ASSERT_EQ(first, second);
+  pool.deallocate(second, 48);
+}
+
+TEST(FreshNodePool, servesAlignedDistinctBlocks) {
+  using namespace std::views;
+  FreshNodePool pool{};
+  std::vector<void *> blocks{};
+  for (auto &&i : iota(0, 10'000)) {
+    blocks.push_back(pool.allocate(24));
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(blocks.back()) %
+                  FreshNodePool::Granularity,
+              0);
+  }
+  std::sort(blocks.begin(), blocks.end());
+  ASSERT_EQ(std::adjacent_find(blocks.begin(), blocks.end()), blocks.end());
+  for (auto &&block : blocks) {
+    pool.deallocate(block, 24);
+  }
+}
+
+TEST(FreshNodePool, forwardsLargeRequestsUpstream) {
+  CountingResource upstream{};
+  FreshNodePool pool{&upstream};
+  auto block{pool.allocate(FreshNodePool::MaxBlockSize + 1)};
+  ASSERT_EQ(upstream.allocations(), 1);
+  pool.deallocate(block, FreshNodePool::MaxBlockSize + 1);
+}
+
+TEST(FreshNodePool, recyclesAcrossThreads) {
+  using namespace std::views;
+  CountingResource upstream{};
+  FreshNodePool pool{&upstream};
+  ConcurrentFreshQueue<void *> handoff{};
+  std::thread consumer{[&] {
+    for (auto &&i : iota(0, 100'000)) {
+      void *block{};
+      handoff.waitAndPop(block);
+      pool.deallocate(block, 32);
+    }
+  }};
+  for (auto &&i : iota(0, 100'000)) {
+    handoff.push(pool.allocate(32));
+  }
+  consumer.join();
+  ASSERT_LT(upstream.allocations(), 100'000 / (FreshNodePool::ChunkSize / 32));
+}
+
+// Tests for LockFreeFreshQueue
+
+TEST(LockFreeFreshQueueOfInts, initiallyEmptyEmpty) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(LockFreeFreshQueueOfInts, onePushEmpty) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  freshQueue.push(42);
+  ASSERT_FALSE(freshQueue.empty());
+}
+
+TEST(LockFreeFreshQueueOfInts, manyPushSize) {
+  using namespace std::views;
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  for (auto &&i : iota(0, 10)) {
+    freshQueue.push(i);
+  }
+  ASSERT_EQ(freshQueue.size(), 10);
+}
+
+TEST(LockFreeFreshQueueOfInts, fullTryPush) {
+  using namespace std::views;
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  for (auto &&i : iota(0, 16)) {
+    ASSERT_TRUE(freshQueue.tryPush(i));
+  }
+  ASSERT_FALSE(freshQueue.tryPush(42));
+  ASSERT_EQ(freshQueue.size(), 16);
+}
+
+TEST(LockFreeFreshQueueOfInts, initiallyEmptyTryPopByValue) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  int value{};
+  ASSERT_FALSE(freshQueue.tryPop(value));
+}
+
+TEST(LockFreeFreshQueueOfInts, initiallyEmptyTryPopByPointer) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  ASSERT_EQ(freshQueue.tryPop(), nullptr);
+}
+
+TEST(LockFreeFreshQueueOfInts, pushAndTryPopByValue) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  freshQueue.push(42);
+  int value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_EQ(value, 42);
+}
+
+TEST(LockFreeFreshQueueOfInts, pushAndTryPopByPointer) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  freshQueue.push(42);
+  auto result{freshQueue.tryPop()};
+  ASSERT_EQ(*result, 42);
+}
+
+TEST(LockFreeFreshQueueOfInts, pushAndPopWrapsAround) {
+  using namespace std::views;
+  LockFreeFreshQueue<int, 4> freshQueue{};
+  int value{};
+  for (auto &&i : iota(0, 100)) {
+    freshQueue.push(i);
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(LockFreeFreshQueueOfInts, waitAndPopByValueThenPush) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  int value{};
+  std::thread popThread{[&] { freshQueue.waitAndPop(value); }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.push(42);
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(value, 42);
+}
+
+TEST(LockFreeFreshQueueOfInts, waitAndPopByPointerThenPush) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  std::shared_ptr<int> result{};
+  std::thread popThread{[&] { result = freshQueue.waitAndPop(); }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.push(42);
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(*result, 42);
+}
+
+TEST(LockFreeFreshQueueOfInts, manyWaitAndPopThenPush) {
+  LockFreeFreshQueue<int, 16> freshQueue{};
+  int value{};
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 1'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
+}
+
+TEST(LockFreeFreshQueueOfInts, manyProducersAndConsumers) {
+  using namespace std::views;
+  LockFreeFreshQueue<int, 64> freshQueue{};
+  std::atomic<long> sum{};
+  std::vector<std::thread> threads{};
+  for (auto &&t : iota(0, 4)) {
+    threads.emplace_back([&, t] {
+      for (auto &&i : iota(0, 1'000)) {
+        freshQueue.push(t * 1'000 + i);
+      }
+    });
+    threads.emplace_back([&] {
+      int value{};
+      for (auto &&i : iota(0, 1'000)) {
+        freshQueue.waitAndPop(value);
+        sum += value;
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, 3'999 * 4'000 / 2);
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(LockFreeFreshQueueOfSharedPointers, destroysRemainingElements) {
+  auto tracked{std::make_shared<int>(42)};
+  {
+    LockFreeFreshQueue<std::shared_ptr<int>, 4> freshQueue{};
+    freshQueue.push(tracked);
+    freshQueue.push(tracked);
+    ASSERT_EQ(tracked.use_count(), 3);
+  }
+  ASSERT_EQ(tracked.use_count(), 1);
+}
+
+// Tests for SpscFreshQueue
+
+TEST(SpscFreshQueueOfInts, initiallyEmptyEmpty) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(SpscFreshQueueOfInts, onePushEmpty) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  freshQueue.push(42);
+  ASSERT_FALSE(freshQueue.empty());
+}
+
+TEST(SpscFreshQueueOfInts, manyPushSize) {
+  using namespace std::views;
+  SpscFreshQueue<int, 16> freshQueue{};
+  for (auto &&i : iota(0, 10)) {
+    freshQueue.push(i);
+  }
+  ASSERT_EQ(freshQueue.size(), 10);
+}
+
+TEST(SpscFreshQueueOfInts, fullTryPush) {
+  using namespace std::views;
+  SpscFreshQueue<int, 16> freshQueue{};
+  for (auto &&i : iota(0, 16)) {
+    ASSERT_TRUE(freshQueue.tryPush(i));
+  }
+  ASSERT_FALSE(freshQueue.tryPush(42));
+  ASSERT_EQ(freshQueue.size(), 16);
+}
+
+TEST(SpscFreshQueueOfInts, initiallyEmptyTryPopByValue) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  int value{};
+  ASSERT_FALSE(freshQueue.tryPop(value));
+}
+
+TEST(SpscFreshQueueOfInts, initiallyEmptyTryPopByPointer) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  ASSERT_EQ(freshQueue.tryPop(), nullptr);
+}
+
+TEST(SpscFreshQueueOfInts, pushAndTryPopByValue) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  freshQueue.push(42);
+  int value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_EQ(value, 42);
+}
+
+TEST(SpscFreshQueueOfInts, pushAndTryPopByPointer) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  freshQueue.push(42);
+  auto result{freshQueue.tryPop()};
+  ASSERT_EQ(*result, 42);
+}
+
+TEST(SpscFreshQueueOfInts, pushAndPopWrapsAround) {
+  using namespace std::views;
+  SpscFreshQueue<int, 4> freshQueue{};
+  int value{};
+  for (auto &&i : iota(0, 100)) {
+    freshQueue.push(i);
+    ASSERT_TRUE(freshQueue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(SpscFreshQueueOfInts, waitAndPopByPointerThenPush) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  std::shared_ptr<int> result{};
+  std::thread popThread{[&] { result = freshQueue.waitAndPop(); }};
+  std::thread pushThread{[&] {
+    using namespace std::chrono;
+    std::this_thread::sleep_for(10ms);
+    freshQueue.push(42);
+  }};
+  popThread.join();
+  pushThread.join();
+  ASSERT_EQ(*result, 42);
+}
+
+TEST(SpscFreshQueueOfInts, manyWaitAndPopThenPush) {
+  SpscFreshQueue<int, 16> freshQueue{};
+  int value{};
+  std::thread popThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 10'000)) {
+      freshQueue.waitAndPop(value);
+      ASSERT_EQ(value, i);
+    }
+  }};
+  std::thread pushThread{[&] {
+    using namespace std::views;
+    for (auto &&i : iota(0, 10'000)) {
+      freshQueue.push(i);
+    }
+  }};
+  popThread.join();
+  pushThread.join();
+}
+
+TEST(SpscFreshQueueOfStrings, pushAndPopMovesElements) {
+  SpscFreshQueue<std::string, 4> freshQueue{};
+  freshQueue.push(std::string(64, 'x'));
+  std::string value{};
+  ASSERT_TRUE(freshQueue.tryPop(value));
+  ASSERT_EQ(value, std::string(64, 'x'));
+}
+
+// Tests for WorkStealingFreshDeque
+
+TEST(WorkStealingFreshDequeOfInts, initiallyEmptyPop) {
+  WorkStealingFreshDeque<int> deque{};
+  ASSERT_TRUE(deque.empty());
+  ASSERT_FALSE(deque.pop());
+  ASSERT_FALSE(deque.steal());
+}
+
+TEST(WorkStealingFreshDequeOfInts, nonPowerOfTwoCapacityThrows) {
+  ASSERT_THROW(WorkStealingFreshDeque<int>{3}, std::invalid_argument);
+}
+
+TEST(WorkStealingFreshDequeOfInts, popTakesNewestAndStealTakesOldest) {
+  WorkStealingFreshDeque<int> deque{};
+  deque.push(1);
+  deque.push(2);
+  deque.push(3);
+  ASSERT_EQ(deque.size(), 3);
+  ASSERT_EQ(deque.pop(), 3);
+  ASSERT_EQ(deque.steal(), 1);
+  ASSERT_EQ(deque.pop(), 2);
+  ASSERT_TRUE(deque.empty());
+}
+
+TEST(WorkStealingFreshDequeOfInts, pushBeyondCapacityGrows) {
+  using namespace std::views;
+  WorkStealingFreshDeque<int> deque{2};
+  for (auto &&i : iota(0, 100)) {
+    deque.push(i);
+  }
+  ASSERT_EQ(deque.size(), 100);
+  for (auto &&i : iota(0, 100)) {
+    ASSERT_EQ(deque.steal(), i);
+  }
+}
+
+TEST(WorkStealingFreshDequeOfInts, ownerAndThievesTakeEachElementOnce) {
+  using namespace std::views;
+  constexpr int count{100'000};
+  WorkStealingFreshDeque<int> deque{4};
+  std::atomic<bool> done{};
+  std::atomic<long> sum{};
+  std::atomic<int> taken{};
+  std::vector<std::thread> thieves{};
+  for (auto &&t : iota(0, 3)) {
+    thieves.emplace_back([&] {
+      while (!done || !deque.empty()) {
+        if (auto value{deque.steal()}) {
+          sum += *value;
+          ++taken;
+        }
+      }
+    });
+  }
+  for (auto &&i : iota(1, count + 1)) {
+    deque.push(i);
+    if (i % 3 == 0) {
+      if (auto value{deque.pop()}) {
+        sum += *value;
+        ++taken;
+      }
+    }
+  }
+  while (auto value{deque.pop()}) {
+    sum += *value;
+    ++taken;
+  }
+  done = true;
+  for (auto &&thread : thieves) {
+    thread.join();
+  }
+  ASSERT_EQ(taken, count);
+  ASSERT_EQ(sum, static_cast<long>(count) * (count + 1) / 2);
+}
+
+// Tests for FreshThreadPool
+
+TEST(FreshThreadPool, zeroWorkersThrows) {
+  ASSERT_THROW(FreshThreadPool{0}, std::invalid_argument);
+}
+
+TEST(FreshThreadPool, submitFromOutsideRuns) {
+  FreshThreadPool pool{2};
+  std::atomic<int> count{};
+  for (auto &&_ : std::views::iota(0, 100)) {
+    pool.submit([&] { ++count; });
+  }
+  pool.runUntil([&] { return count == 100; });
+  ASSERT_EQ(count, 100);
+}
+
+TEST(FreshThreadPool, destructorRunsQueuedTasks) {
+  std::atomic<int> count{};
+  {
+    FreshThreadPool pool{2};
+    for (auto &&_ : std::views::iota(0, 100)) {
+      pool.submit([&] { ++count; });
+    }
+  }
+  ASSERT_EQ(count, 100);
+}
+
+namespace {
+int fib(FreshThreadPool &pool, int n) {
+  if (n < 2)
+    return n;
+  std::atomic<bool> done{};
+  int left{};
+  pool.submit([&] {
+    left = fib(pool, n - 1);
+    done.store(true, std::memory_order_release);
+  });
+  auto right{fib(pool, n - 2)};
+  pool.runUntil([&] { return done.load(std::memory_order_acquire); });
+  return left + right;
+}
+} // namespace
+
+TEST(FreshThreadPool, forkJoinFib) {
+  FreshThreadPool pool{4};
+  std::atomic<int> result{};
+  std::atomic<bool> done{};
+  pool.submit([&] {
+    result = fib(pool, 20);
+    done = true;
+  });
+  pool.runUntil([&] { return done.load(); });
+  ASSERT_EQ(result, 6765);
+}
+
+// Tests for asyncPop
+
+namespace {
+template <typename Queue, typename... Executor>
+FreshTask asyncPopInto(Queue &queue, std::vector<int> &values, int count,
+                       Executor... executor) {
+  for (int i{}; i < count; ++i) {
+    values.push_back(co_await queue.asyncPop(executor...));
+  }
+}
+
+template <typename Queue>
+FreshTask asyncPopAndCount(Queue &queue, std::atomic<int> &popped, int count,
+                           FreshThreadPool &pool) {
+  auto onPool{[&pool](std::coroutine_handle<> coroutine) {
+    pool.submit([coroutine] { coroutine.resume(); });
+  }};
+  for (int i{}; i < count; ++i) {
+    co_await queue.asyncPop(onPool);
+    ++popped;
+  }
+}
+} // namespace
+
+TEST(FreshTask, runsUntilFirstSuspension) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  freshQueue.push(1);
+  std::vector<int> values{};
+  asyncPopInto(freshQueue, values, 2);
+  ASSERT_EQ(values, std::vector<int>{1});
+  freshQueue.push(2);
+  ASSERT_EQ(values, (std::vector<int>{1, 2}));
+}
+
+TEST(ThreadSafeFreshQueueOfInts, pushResumesAsyncPopsInOrder) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  std::vector<int> first{};
+  std::vector<int> second{};
+  asyncPopInto(freshQueue, first, 2);
+  asyncPopInto(freshQueue, second, 1);
+  freshQueue.push(1);
+  freshQueue.push(2);
+  freshQueue.push(3);
+  ASSERT_EQ(first, (std::vector<int>{1, 3}));
+  ASSERT_EQ(second, std::vector<int>{2});
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ThreadSafeFreshQueueOfInts, pushRangeResumesManyAsyncPops) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  std::vector<int> values{};
+  for (int i{}; i < 4; ++i) {
+    asyncPopInto(freshQueue, values, 1);
+  }
+  std::vector<int> range{1, 2, 3, 4};
+  freshQueue.push(std::span<const int>{range});
+  ASSERT_EQ(values, range);
+}
+
+TEST(ThreadSafeFreshQueueOfInts, asyncPopHandsCoroutineToExecutor) {
+  ThreadSafeFreshQueue<int> freshQueue{};
+  std::vector<std::coroutine_handle<>> scheduled{};
+  auto executor{[&](std::coroutine_handle<> coroutine) {
+    scheduled.push_back(coroutine);
+  }};
+  std::vector<int> values{};
+  asyncPopInto(freshQueue, values, 1, executor);
+  freshQueue.push(42);
+  ASSERT_EQ(scheduled.size(), 1);
+  ASSERT_TRUE(values.empty());
+  scheduled.front().resume();
+  ASSERT_EQ(values, std::vector<int>{42});
+}
+
+TEST(ConcurrentFreshQueueOfInts, pushResumesAsyncPopsInOrder) {
+  ConcurrentFreshQueue<int> freshQueue{};
+  std::vector<int> first{};
+  std::vector<int> second{};
+  asyncPopInto(freshQueue, first, 2);
+  asyncPopInto(freshQueue, second, 1);
+  freshQueue.push(1);
+  freshQueue.push(2);
+  freshQueue.push(3);
+  ASSERT_EQ(first, (std::vector<int>{1, 3}));
+  ASSERT_EQ(second, std::vector<int>{2});
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ConcurrentFreshQueueOfInts, boundedPushRangeResumesAsyncPops) {
+  ConcurrentFreshQueue<int> freshQueue{4, 2};
+  std::vector<int> values{};
+  asyncPopInto(freshQueue, values, 100);
+  auto numbers{std::views::iota(0, 100)};
+  std::vector<int> range(numbers.begin(), numbers.end());
+  freshQueue.pushRange(range.begin(), range.end());
+  ASSERT_EQ(values, range);
+}
+
+TEST(ConcurrentFreshQueueOfInts, manyAsyncPopsOnFewThreads) {
+  ConcurrentFreshQueue<int> freshQueue{};
+  FreshThreadPool pool{2};
+  std::atomic<int> popped{};
+  for (int i{}; i < 1'000; ++i) {
+    asyncPopAndCount(freshQueue, popped, 10, pool);
+  }
+  std::vector<std::thread> producers{};
+  for (int i{}; i < 4; ++i) {
+    producers.emplace_back([&] {
+      for (int j{}; j < 2'500; ++j) {
+        freshQueue.push(j);
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  pool.runUntil([&] { return popped == 10'000; });
+  ASSERT_TRUE(freshQueue.empty());
+}
+
+TEST(ShardedFreshQueueOfInts, pushResumesAsyncPop) {
+  ShardedFreshQueue<int> freshQueue{4};
+  std::vector<int> values{};
+  asyncPopInto(freshQueue, values, 2);
+  freshQueue.push(1);
+  freshQueue.push(2);
+  ASSERT_EQ(values, (std::vector<int>{1, 2}));
+}
+
+// Tests for SharedMemoryFreshQueue
+
+namespace {
+std::string sharedQueueName(const char *test) {
+  return "/freshqueue-test-" + std::to_string(getpid()) + "-" + test;
+}
+} // namespace
+
+TEST(SharedMemoryFreshQueueOfInts, attachSeesPushesOfCreator) {
+  auto name{sharedQueueName("attach")};
+  auto creator{SharedMemoryFreshQueue<int, 16>::create(name)};
+  auto attached{SharedMemoryFreshQueue<int, 16>::attach(name)};
+  ASSERT_TRUE(attached.empty());
+  creator.push(42);
+  int value{};
+  ASSERT_TRUE(attached.tryPop(value));
+  ASSERT_EQ(value, 42);
+  ASSERT_TRUE(creator.empty());
+}
+
+TEST(SharedMemoryFreshQueueOfInts, tryPushFailsWhenFull) {
+  auto queue{SharedMemoryFreshQueue<int, 4>::create(sharedQueueName("full"))};
+  for (int i{}; i < 4; ++i) {
+    ASSERT_TRUE(queue.tryPush(i));
+  }
+  ASSERT_FALSE(queue.tryPush(4));
+  int value{};
+  ASSERT_TRUE(queue.tryPop(value));
+  ASSERT_EQ(value, 0);
+  ASSERT_TRUE(queue.tryPush(4));
+}
+
+TEST(SharedMemoryFreshQueueOfInts, createExistingNameThrows) {
+  auto name{sharedQueueName("existing")};
+  auto queue{SharedMemoryFreshQueue<int, 16>::create(name)};
+  ASSERT_THROW((SharedMemoryFreshQueue<int, 16>::create(name)),
+               std::system_error);
+}
+
+TEST(SharedMemoryFreshQueueOfInts, attachMissingNameThrows) {
+  ASSERT_THROW(
+      (SharedMemoryFreshQueue<int, 16>::attach(sharedQueueName("missing"))),
+      std::system_error);
+}
+
+TEST(SharedMemoryFreshQueueOfInts, attachWithOtherLayoutThrows) {
+  auto name{sharedQueueName("layout")};
+  auto queue{SharedMemoryFreshQueue<int, 16>::create(name)};
+  ASSERT_THROW((SharedMemoryFreshQueue<int, 8>::attach(name)),
+               std::runtime_error);
+  ASSERT_THROW((SharedMemoryFreshQueue<long, 16>::attach(name)),
+               std::runtime_error);
+}
+
+TEST(SharedMemoryFreshQueueOfInts, creatorUnlinksName) {
+  auto name{sharedQueueName("unlink")};
+  { auto queue{SharedMemoryFreshQueue<int, 16>::create(name)}; }
+  ASSERT_THROW((SharedMemoryFreshQueue<int, 16>::attach(name)),
+               std::system_error);
+}
+
+TEST(SharedMemoryFreshQueueOfInts, pushWaitsForRoom) {
+  auto queue{SharedMemoryFreshQueue<int, 2>::create(sharedQueueName("room"))};
+  queue.push(0);
+  queue.push(1);
+  std::thread pushThread{[&] { queue.push(2); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  int value{};
+  queue.waitAndPop(value);
+  pushThread.join();
+  queue.waitAndPop(value);
+  queue.waitAndPop(value);
+  ASSERT_EQ(value, 2);
+}
+
+TEST(SharedMemoryFreshQueueOfInts, waitAndPopFromForkedProducer) {
+  auto name{sharedQueueName("fork")};
+  auto queue{SharedMemoryFreshQueue<int, 64>::create(name)};
+  auto child{fork()};
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    auto attached{SharedMemoryFreshQueue<int, 64>::attach(name)};
+    for (int i{}; i < 10'000; ++i) {
+      attached.push(i);
+    }
+    _exit(0);
+  }
+  int value{};
+  for (int i{}; i < 10'000; ++i) {
+    queue.waitAndPop(value);
+    ASSERT_EQ(value, i);
+  }
+  int status{};
+  waitpid(child, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+}
+
+// Tests for SpillingFreshQueue
+
+TEST(SpillingFreshQueueOfInts, zeroMemoryLimitThrows) {
+  ASSERT_THROW((SpillingFreshQueue<int>{std::filesystem::temp_directory_path(),
+                                        0}),
+               std::invalid_argument);
+}
+
+TEST(SpillingFreshQueueOfInts, missingDirectoryThrows) {
+  ASSERT_THROW((SpillingFreshQueue<int>{
+                   std::filesystem::temp_directory_path() / "freshqueue-none",
+                   16}),
+               std::invalid_argument);
+}
+
+TEST(SpillingFreshQueueOfInts, staysInMemoryBelowLimit) {
+  SpillingFreshQueue<int, 4> queue{std::filesystem::temp_directory_path(), 8};
+  for (int i{}; i < 8; ++i) {
+    queue.push(i);
+  }
+  ASSERT_EQ(queue.size(), 8);
+  ASSERT_EQ(queue.spilled(), 0);
+}
+
+TEST(SpillingFreshQueueOfInts, spillsPastLimitInOrder) {
+  SpillingFreshQueue<int, 4> queue{std::filesystem::temp_directory_path(), 8};
+  for (int i{}; i < 100; ++i) {
+    queue.push(i);
+  }
+  ASSERT_EQ(queue.size(), 100);
+  ASSERT_EQ(queue.spilled(), 92);
+  int value{};
+  for (int i{}; i < 100; ++i) {
+    ASSERT_TRUE(queue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(queue.empty());
+  ASSERT_FALSE(queue.tryPop(value));
+}
+
+TEST(SpillingFreshQueueOfInts, keepsOrderWhilePushesInterleave) {
+  SpillingFreshQueue<int, 4> queue{std::filesystem::temp_directory_path(), 4};
+  int next{};
+  int expected{};
+  int value{};
+  for (int round{}; round < 50; ++round) {
+    for (int i{}; i < 7; ++i) {
+      queue.push(next++);
+    }
+    for (int i{}; i < 5; ++i) {
+      ASSERT_TRUE(queue.tryPop(value));
+      ASSERT_EQ(value, expected++);
+    }
+  }
+  while (queue.tryPop(value)) {
+    ASSERT_EQ(value, expected++);
+  }
+  ASSERT_EQ(expected, next);
+}
+
+TEST(SpillingFreshQueueOfInts, returnsToMemoryOnceDrained) {
+  SpillingFreshQueue<int, 4> queue{std::filesystem::temp_directory_path(), 2};
+  for (int i{}; i < 10; ++i) {
+    queue.push(i);
+  }
+  int value{};
+  while (queue.tryPop(value)) {
+  }
+  queue.push(10);
+  ASSERT_EQ(queue.spilled(), 0);
+}
+
+TEST(SpillingFreshQueueOfInts, refillsInBoundedChunks) {
+  using Queue = SpillingFreshQueue<int, 4 * 1024>;
+  Queue queue{std::filesystem::temp_directory_path(), 1};
+  constexpr int count{1 + 4 * 1024};
+  for (int i{}; i < count; ++i) {
+    queue.push(i);
+  }
+  int value{};
+  ASSERT_TRUE(queue.tryPop(value));
+  ASSERT_TRUE(queue.tryPop(value));
+  ASSERT_EQ(value, 1);
+  ASSERT_EQ(queue.spilled(), 4 * 1024 - Queue::RefillSize);
+  for (int i{2}; i < count; ++i) {
+    ASSERT_TRUE(queue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(SpillingFreshQueueOfInts, waitAndPopWithProducer) {
+  SpillingFreshQueue<int, 64> queue{std::filesystem::temp_directory_path(),
+                                    128};
+  std::thread producer{[&] {
+    for (int i{}; i < 100'000; ++i) {
+      queue.push(i);
+    }
+  }};
+  int value{};
+  for (int i{}; i < 100'000; ++i) {
+    queue.waitAndPop(value);
+    ASSERT_EQ(value, i);
+  }
+  producer.join();
+}
+
+// Tests for FreshByteRing
+
+namespace {
+void writeRecord(FreshByteRing &ring, std::size_t size, std::uint8_t fill) {
+  auto record{ring.claim(size)};
+  std::fill(record.begin(), record.end(), std::byte{fill});
+  ring.commit(record);
+}
+} // namespace
+
+TEST(FreshByteRing, capacityNotPowerOfTwoThrows) {
+  ASSERT_THROW(FreshByteRing{100}, std::invalid_argument);
+}
+
+TEST(FreshByteRing, oversizedClaimThrows) {
+  FreshByteRing ring{256};
+  ASSERT_EQ(ring.maxRecordSize(), 120);
+  ASSERT_THROW(ring.tryClaim(121), std::invalid_argument);
+}
+
+TEST(FreshByteRing, initiallyEmptyRead) {
+  FreshByteRing ring{256};
+  ASSERT_TRUE(ring.empty());
+  ASSERT_FALSE(ring.tryRead());
+}
+
+TEST(FreshByteRing, readsRecordsInClaimOrder) {
+  FreshByteRing ring{256};
+  writeRecord(ring, 3, 1);
+  writeRecord(ring, 0, 2);
+  writeRecord(ring, 17, 3);
+  auto record{ring.read()};
+  ASSERT_EQ(record.size(), 3);
+  ASSERT_EQ(record[2], std::byte{1});
+  ring.release();
+  ASSERT_EQ(ring.read().size(), 0);
+  ring.release();
+  record = ring.read();
+  ASSERT_EQ(record.size(), 17);
+  ASSERT_EQ(record[16], std::byte{3});
+  ring.release();
+  ASSERT_TRUE(ring.empty());
+}
+
+TEST(FreshByteRing, uncommittedClaimHoldsBackLaterRecords) {
+  FreshByteRing ring{256};
+  auto first{ring.claim(8)};
+  writeRecord(ring, 8, 2);
+  ASSERT_FALSE(ring.tryRead());
+  ring.commit(first);
+  ASSERT_TRUE(ring.tryRead());
+}
+
+TEST(FreshByteRing, claimFailsWhenFull) {
+  FreshByteRing ring{128};
+  writeRecord(ring, 56, 1);
+  writeRecord(ring, 56, 2);
+  ASSERT_FALSE(ring.tryClaim(1));
+  ring.read();
+  ring.release();
+  ASSERT_TRUE(ring.tryClaim(1));
+}
+
+TEST(FreshByteRing, recordsWrapAroundContiguously) {
+  FreshByteRing ring{128};
+  for (std::uint8_t i{}; i < 100; ++i) {
+    const std::size_t size{static_cast<std::size_t>(i % 5) * 11};
+    writeRecord(ring, size, i);
+    auto record{ring.read()};
+    ASSERT_EQ(record.size(), size);
+    ASSERT_TRUE(std::all_of(record.begin(), record.end(),
+                            [&](std::byte b) { return b == std::byte{i}; }));
+    ring.release();
+  }
+}
+
+TEST(FreshByteRing, manyProducersOneConsumer) {
+  FreshByteRing ring{1 << 12};
+  constexpr int Producers{4};
+  constexpr int PerProducer{10'000};
+  std::vector<std::thread> producers{};
+  for (int p{}; p < Producers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i{}; i < PerProducer; ++i) {
+        auto record{
+            ring.claim(sizeof(int) * 2 + static_cast<std::size_t>(i % 64))};
+        const int header[2]{p, i};
+        std::memcpy(record.data(), header, sizeof(header));
+        ring.commit(record);
+      }
+    });
+  }
+  std::array<int, Producers> next{};
+  for (int i{}; i < Producers * PerProducer; ++i) {
+    auto record{ring.read()};
+    int header[2]{};
+    std::memcpy(header, record.data(), sizeof(header));
+    ASSERT_EQ(record.size(),
+              sizeof(header) + static_cast<std::size_t>(header[1] % 64));
+    ASSERT_EQ(header[1], next[static_cast<std::size_t>(header[0])]++);
+    ring.release();
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  ASSERT_TRUE(ring.empty());
+}
+
+// Tests for BroadcastFreshQueue
+
+TEST(BroadcastFreshQueueOfInts, everyCursorSeesEveryElement) {
+  BroadcastFreshQueue<int, 8> queue{};
+  auto &first{queue.subscribe()};
+  auto &second{queue.subscribe()};
+  for (int i{}; i < 5; ++i) {
+    queue.push(i);
+  }
+  int value{};
+  for (int i{}; i < 5; ++i) {
+    ASSERT_TRUE(first.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(first.tryPop(value));
+  ASSERT_EQ(second.backlog(), 5);
+  ASSERT_TRUE(second.tryPop(value));
+  ASSERT_EQ(value, 0);
+}
+
+TEST(BroadcastFreshQueueOfInts, subscribeAfterPushThrows) {
+  BroadcastFreshQueue<int, 8> queue{};
+  queue.subscribe();
+  queue.push(1);
+  ASSERT_THROW(queue.subscribe(), std::logic_error);
+}
+
+TEST(BroadcastFreshQueueOfInts, subscribeAfterForeignCursorThrows) {
+  BroadcastFreshQueue<int, 8> queue{};
+  BroadcastFreshQueue<int, 8> other{};
+  auto &foreign{other.subscribe()};
+  ASSERT_THROW(queue.subscribe({&foreign}), std::invalid_argument);
+}
+
+TEST(BroadcastFreshQueueOfInts, dependentCursorWaitsForItsDependency) {
+  BroadcastFreshQueue<int, 8> queue{};
+  auto &risk{queue.subscribe()};
+  auto &persister{queue.subscribe({&risk})};
+  queue.push(1);
+  queue.push(2);
+  int value{};
+  ASSERT_FALSE(persister.tryPop(value));
+  ASSERT_TRUE(risk.tryPop(value));
+  ASSERT_TRUE(persister.tryPop(value));
+  ASSERT_EQ(value, 1);
+  ASSERT_FALSE(persister.tryPop(value));
+}
+
+TEST(BroadcastFreshQueueOfInts, slowestCursorGatesWrapAround) {
+  BroadcastFreshQueue<int, 4> queue{};
+  auto &fast{queue.subscribe()};
+  auto &slow{queue.subscribe()};
+  int value{};
+  for (int i{}; i < 4; ++i) {
+    ASSERT_TRUE(queue.tryPush(i));
+    ASSERT_TRUE(fast.tryPop(value));
+  }
+  ASSERT_FALSE(queue.tryPush(4));
+  ASSERT_TRUE(slow.tryPop(value));
+  ASSERT_TRUE(queue.tryPush(4));
+  ASSERT_FALSE(queue.tryPush(5));
+}
+
+TEST(BroadcastFreshQueueOfInts, pushWithoutCursorsNeverBlocks) {
+  BroadcastFreshQueue<int, 4> queue{};
+  for (int i{}; i < 10; ++i) {
+    queue.push(i);
+  }
+}
+
+TEST(BroadcastFreshQueueOfInts, producersAndChainedConsumers) {
+  BroadcastFreshQueue<int, 64> queue{};
+  auto &logger{queue.subscribe()};
+  auto &risk{queue.subscribe()};
+  auto &persister{queue.subscribe({&logger, &risk})};
+  constexpr int Producers{3};
+  constexpr int PerProducer{10'000};
+  constexpr int Total{Producers * PerProducer};
+  auto consume{[&](BroadcastFreshQueue<int, 64>::Cursor &cursor) {
+    long long sum{};
+    int value{};
+    for (int i{}; i < Total; ++i) {
+      cursor.waitAndPop(value);
+      sum += value;
+    }
+    return sum;
+  }};
+  long long loggerSum{};
+  long long riskSum{};
+  long long persisterSum{};
+  std::thread loggerThread{[&] { loggerSum = consume(logger); }};
+  std::thread riskThread{[&] { riskSum = consume(risk); }};
+  std::thread persisterThread{[&] { persisterSum = consume(persister); }};
+  std::vector<std::thread> producers{};
+  for (int p{}; p < Producers; ++p) {
+    producers.emplace_back([&] {
+      for (int i{}; i < PerProducer; ++i) {
+        queue.push(i);
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  loggerThread.join();
+  riskThread.join();
+  persisterThread.join();
+  const long long expected{Producers * (PerProducer - 1LL) * PerProducer / 2};
+  ASSERT_EQ(loggerSum, expected);
+  ASSERT_EQ(riskSum, expected);
+  ASSERT_EQ(persisterSum, expected);
+}
+
+// Tests for FreshHazardDomain
+
+namespace {
+struct TrackedNode {
+  explicit TrackedNode(std::atomic<int> &deleted) : deleted{deleted} {}
+  ~TrackedNode() { ++deleted; }
+  std::atomic<int> &deleted;
+};
+} // namespace
+
+TEST(FreshHazardDomain, protectedNodeOutlivesScans) {
+  std::atomic<int> protectedDeleted{};
+  std::atomic<int> othersDeleted{};
+  FreshHazardDomain domain{};
+  std::atomic<TrackedNode *> shared{new TrackedNode{protectedDeleted}};
+  FreshHazardDomain::Guard reader{domain};
+  FreshHazardDomain::Guard writer{domain};
+  auto node{reader.protect(0, shared)};
+  shared.store(nullptr);
+  writer.retire(node);
+  for (int i{}; i < 1000; ++i) {
+    writer.retire(new TrackedNode{othersDeleted});
+  }
+  ASSERT_EQ(protectedDeleted, 0);
+  ASSERT_GT(othersDeleted, 0);
+  reader.clear(0);
+  for (int i{}; i < 1000; ++i) {
+    writer.retire(new TrackedNode{othersDeleted});
+  }
+  ASSERT_EQ(protectedDeleted, 1);
+}
+
+TEST(FreshHazardDomain, destructionDeletesRetiredNodes) {
+  std::atomic<int> deleted{};
+  {
+    FreshHazardDomain domain{};
+    FreshHazardDomain::Guard guard{domain};
+    guard.retire(new TrackedNode{deleted});
+  }
+  ASSERT_EQ(deleted, 1);
+}
+
+// Tests for UnboundedLockFreeFreshQueue
+
+TEST(UnboundedLockFreeFreshQueueOfInts, initiallyEmptyTryPop) {
+  UnboundedLockFreeFreshQueue<int> queue{};
+  int value{};
+  ASSERT_TRUE(queue.empty());
+  ASSERT_FALSE(queue.tryPop(value));
+}
+
+TEST(UnboundedLockFreeFreshQueueOfInts, popsInPushOrder) {
+  UnboundedLockFreeFreshQueue<int> queue{};
+  for (int i{}; i < 10'000; ++i) {
+    queue.push(i);
+  }
+  int value{};
+  for (int i{}; i < 10'000; ++i) {
+    ASSERT_TRUE(queue.tryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(UnboundedLockFreeFreshQueueOfInts, holdsMoveOnlyElements) {
+  UnboundedLockFreeFreshQueue<std::unique_ptr<int>> queue{};
+  queue.push(std::make_unique<int>(42));
+  std::unique_ptr<int> value{};
+  ASSERT_TRUE(queue.tryPop(value));
+  ASSERT_EQ(*value, 42);
+}
+
+TEST(UnboundedLockFreeFreshQueueOfInts, destructionFreesElements) {
+  auto element{std::make_shared<int>(1)};
+  {
+    UnboundedLockFreeFreshQueue<std::shared_ptr<int>> queue{};
+    for (int i{}; i < 1000; ++i) {
+      queue.push(element);
+    }
+    std::shared_ptr<int> value{};
+    for (int i{}; i < 500; ++i) {
+      queue.tryPop(value);
+    }
+  }
+  ASSERT_EQ(element.use_count(), 1);
+}
+
+TEST(UnboundedLockFreeFreshQueueOfInts, stressManyProducersManyConsumers) {
+  UnboundedLockFreeFreshQueue<int> queue{};
+  constexpr int Threads{32};
+  constexpr int PerProducer{5'000};
+  std::atomic<long long> sum{};
+  std::vector<std::thread> threads{};
+  for (int t{}; t < Threads; ++t) {
+    threads.emplace_back([&] {
+      for (int i{}; i < PerProducer; ++i) {
+        queue.push(i);
+      }
+    });
+    threads.emplace_back([&] {
+      long long local{};
+      int value{};
+      for (int i{}; i < PerProducer; ++i) {
+        queue.waitAndPop(value);
+        local += value;
+      }
+      sum += local;
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(sum, Threads * (PerProducer - 1LL) * PerProducer / 2);
+  ASSERT_TRUE(queue.empty());
+}
+
+// Tests for move-only elements and emplace across the queues
+
+namespace {
+struct Tally {
+  int copies{};
+  int moves{};
+};
+
+// Records every copy and move of itself in a shared Tally.
+class Counted {
+public:
+  Counted(Tally &tally, int value) noexcept
+      : m_tally{&tally}, m_value{value} {}
+  Counted(const Counted &other)
+      : m_tally{other.m_tally}, m_value{other.m_value} {
+    ++m_tally->copies;
+  }
+  Counted(Counted &&other) noexcept
+      : m_tally{other.m_tally}, m_value{other.m_value} {
+    ++m_tally->moves;
+  }
+  Counted &operator=(const Counted &other) {
+    m_tally = other.m_tally;
+    m_value = other.m_value;
+    ++m_tally->copies;
+    return *this;
+  }
+  Counted &operator=(Counted &&other) noexcept {
+    m_tally = other.m_tally;
+    m_value = other.m_value;
+    ++m_tally->moves;
+    return *this;
+  }
+  ~Counted() = default;
+
+  int value() const noexcept { return m_value; }
+
+private:
+  Tally *m_tally;
+  int m_value;
+};
+
+template <typename Queue> void roundTripUniquePointers(Queue &queue) {
+  queue.push(std::make_unique<int>(1));
+  queue.emplace(std::make_unique<int>(2));
+  std::unique_ptr<int> value{};
+  queue.waitAndPop(value);
+  ASSERT_EQ(*value, 1);
+  queue.waitAndPop(value);
+  ASSERT_EQ(*value, 2);
+}
+
+// Pushes an rvalue and emplaces from constructor arguments, then pops both:
+// nothing may be copied on the way.
+template <typename Queue> void roundTripWithoutCopies(Queue &queue) {
+  Tally tally{};
+  queue.push(Counted{tally, 1});
+  queue.emplace(tally, 2);
+  Counted value{tally, 0};
+  queue.waitAndPop(value);
+  ASSERT_EQ(value.value(), 1);
+  queue.waitAndPop(value);
+  ASSERT_EQ(value.value(), 2);
+  ASSERT_EQ(tally.copies, 0);
+}
+} // namespace
+
+TEST(MoveOnlyElements, threadSafeFreshQueue) {
+  ThreadSafeFreshQueue<std::unique_ptr<int>> queue{};
+  roundTripUniquePointers(queue);
+  ThreadSafeFreshQueue<std::unique_ptr<int>, SharedStorage> shared{};
+  roundTripUniquePointers(shared);
+}
+
+TEST(MoveOnlyElements, concurrentFreshQueue) {
+  ConcurrentFreshQueue<std::unique_ptr<int>> queue{};
+  roundTripUniquePointers(queue);
+}
+
+TEST(MoveOnlyElements, concurrentFreshQueueFailedTryPushKeepsValue) {
+  ConcurrentFreshQueue<std::unique_ptr<int>> queue{1};
+  ASSERT_TRUE(queue.tryPush(std::make_unique<int>(1)));
+  auto value{std::make_unique<int>(2)};
+  ASSERT_FALSE(queue.tryPush(std::move(value)));
+  ASSERT_TRUE(value);
+  ASSERT_EQ(*value, 2);
+}
+
+TEST(MoveOnlyElements, segmentedFreshQueue) {
+  SegmentedFreshQueue<std::unique_ptr<int>> queue{};
+  roundTripUniquePointers(queue);
+}
+
+TEST(MoveOnlyElements, shardedFreshQueue) {
+  ShardedFreshQueue<std::unique_ptr<int>> queue{2};
+  roundTripUniquePointers(queue);
+}
+
+TEST(MoveOnlyElements, priorityFreshQueue) {
+  PriorityFreshQueue<std::unique_ptr<int>> queue{};
+  queue.push(std::make_unique<int>(1), 3);
+  queue.emplace(0, std::make_unique<int>(2));
+  std::unique_ptr<int> value{};
+  queue.waitAndPop(value);
+  ASSERT_EQ(*value, 2);
+  queue.waitAndPop(value);
+  ASSERT_EQ(*value, 1);
+}
+
+TEST(MoveOnlyElements, lockFreeFreshQueues) {
+  LockFreeFreshQueue<std::unique_ptr<int>, 4> ring{};
+  roundTripUniquePointers(ring);
+  UnboundedLockFreeFreshQueue<std::unique_ptr<int>> linked{};
+  roundTripUniquePointers(linked);
+  SpscFreshQueue<std::unique_ptr<int>, 4> spsc{};
+  roundTripUniquePointers(spsc);
+}
+
+TEST(MoveOnlyElements, pushAndEmplaceNeverCopy) {
+  ThreadSafeFreshQueue<Counted> threadSafe{};
+  roundTripWithoutCopies(threadSafe);
+  ConcurrentFreshQueue<Counted> concurrent{};
+  roundTripWithoutCopies(concurrent);
+  SegmentedFreshQueue<Counted> segmented{};
+  roundTripWithoutCopies(segmented);
+  ShardedFreshQueue<Counted> sharded{1};
+  roundTripWithoutCopies(sharded);
+  LockFreeFreshQueue<Counted, 4> ring{};
+  roundTripWithoutCopies(ring);
+  UnboundedLockFreeFreshQueue<Counted> linked{};
+  roundTripWithoutCopies(linked);
+  SpscFreshQueue<Counted, 4> spsc{};
+  roundTripWithoutCopies(spsc);
+}
+
+TEST(MoveOnlyElements, emplaceConstructsInPlace) {
+  Tally tally{};
+  ConcurrentFreshQueue<Counted> concurrent{};
+  concurrent.emplace(tally, 1);
+  SegmentedFreshQueue<Counted> segmented{};
+  segmented.emplace(tally, 1);
+  LockFreeFreshQueue<Counted, 4> ring{};
+  ring.emplace(tally, 1);
+  ASSERT_EQ(tally.copies, 0);
+  ASSERT_EQ(tally.moves, 0);
+}
+
+// Tests for FreshPipeline
+
+namespace {
+// Counts up to count, one element per call.
+auto numbersBelow(int count) {
+  return [next = 0, count]() mutable -> std::optional<int> {
+    if (next == count)
+      return std::nullopt;
+    return next++;
+  };
+}
+} // namespace
+
+TEST(FreshPipeline, tokensOutsideLinkCapacityThrow) {
+  ASSERT_THROW(FreshPipeline<>{0}, std::invalid_argument);
+  ASSERT_THROW((FreshPipeline<8>{16}), std::invalid_argument);
+}
+
+TEST(FreshPipeline, serialChainUsesSpscLinksInOrder) {
+  FreshPipeline<> pipeline{16};
+  auto numbers{pipeline.source(numbersBelow(1000))};
+  auto doubled{pipeline.stage(numbers, 1, [](int value) { return 2 * value; })};
+  std::vector<int> seen{};
+  pipeline.sink(doubled, 1, [&](int value) { seen.push_back(value); });
+  ASSERT_EQ(pipeline.linkCount(), 2);
+  ASSERT_EQ(pipeline.spscLinkCount(), 2);
+  pipeline.run();
+  ASSERT_EQ(seen.size(), 1000);
+  for (int i{}; i < 1000; ++i) {
+    ASSERT_EQ(seen[static_cast<std::size_t>(i)], 2 * i);
+  }
+}
+
+TEST(FreshPipeline, serialSinkRestoresOrderBehindParallelStage) {
+  FreshPipeline<> pipeline{32};
+  auto numbers{pipeline.source(numbersBelow(2000))};
+  auto shuffled{pipeline.stage(numbers, 4, [](int value) {
+    if (value % 7 == 0)
+      std::this_thread::yield();
+    return value;
+  })};
+  std::vector<int> seen{};
+  pipeline.sink(shuffled, 1, [&](int value) { seen.push_back(value); });
+  ASSERT_EQ(pipeline.spscLinkCount(), 0);
+  pipeline.run();
+  ASSERT_EQ(seen.size(), 2000);
+  for (int i{}; i < 2000; ++i) {
+    ASSERT_EQ(seen[static_cast<std::size_t>(i)], i);
+  }
+}
+
+TEST(FreshPipeline, fanOutCopiesToEveryBranchAndFanInMerges) {
+  FreshPipeline<> pipeline{64};
+  auto numbers{pipeline.source(numbersBelow(1000))};
+  auto incremented{pipeline.stage(numbers, 2, [](int value) {
+    return static_cast<long>(value) + 1;
+  })};
+  auto scaled{pipeline.stage(numbers, 1, [](int value) {
+    return static_cast<long>(value) * 10;
+  })};
+  std::atomic<long> sum{};
+  std::atomic<int> count{};
+  pipeline.sink({incremented, scaled}, 3, [&](long value) {
+    sum += value;
+    ++count;
+  });
+  pipeline.run();
+  ASSERT_EQ(count, 2000);
+  ASSERT_EQ(sum, 999 * 1000 / 2 + 1000 + 10 * (999 * 1000 / 2));
+}
+
+TEST(FreshPipeline, tokensBoundElementsInFlight) {
+  FreshPipeline<> pipeline{4};
+  std::atomic<int> inFlight{};
+  std::atomic<int> highWater{};
+  auto numbers{pipeline.source([&, next = 0]() mutable -> std::optional<int> {
+    if (next == 500)
+      return std::nullopt;
+    auto current{++inFlight};
+    auto seen{highWater.load()};
+    while (current > seen && !highWater.compare_exchange_weak(seen, current))
+      ;
+    return next++;
+  })};
+  auto passed{pipeline.stage(numbers, 3, [](int value) { return value; })};
+  pipeline.sink(passed, 1, [&](int) {
+    std::this_thread::yield();
+    --inFlight;
+  });
+  pipeline.run();
+  ASSERT_EQ(inFlight, 0);
+  ASSERT_LE(highWater, 4);
+}
+
+TEST(FreshPipeline, movesMoveOnlyElementsButCannotFanThemOut) {
+  FreshPipeline<> pipeline{8};
+  auto numbers{pipeline.source(numbersBelow(100))};
+  auto boxed{pipeline.stage(numbers, 2, [](int value) {
+    return std::make_unique<int>(value);
+  })};
+  int sum{};
+  pipeline.sink(boxed, 1, [&](std::unique_ptr<int> value) { sum += *value; });
+  ASSERT_THROW(pipeline.sink(boxed, 1, [](std::unique_ptr<int>) {}),
+               std::invalid_argument);
+  pipeline.run();
+  ASSERT_EQ(sum, 99 * 100 / 2);
+}
+
+TEST(FreshPipeline, unconsumedStageThrows) {
+  FreshPipeline<> pipeline{8};
+  auto numbers{pipeline.source(numbersBelow(10))};
+  pipeline.stage(numbers, 1, [](int value) { return value; });
+  ASSERT_THROW(pipeline.run(), std::logic_error);
+}
+
+TEST(FreshPipeline, stageExceptionStopsSourcesAndIsRethrown) {
+  FreshPipeline<> pipeline{8};
+  auto endless{pipeline.source(
+      [next = 0]() mutable -> std::optional<int> { return next++; })};
+  auto checked{pipeline.stage(endless, 2, [](int value) {
+    if (value == 100)
+      throw std::runtime_error{"bad element"};
+    return value;
+  })};
+  pipeline.sink(checked, 1, [](int) {});
+  ASSERT_THROW(pipeline.run(), std::runtime_error);
+  ASSERT_THROW(pipeline.run(), std::logic_error);
+}
+
+// Tests for FreshQueue
+
+namespace {
+// Calls check.template operator()<Queue>() for every FreshQueue of T with one
+// or many producers and consumers, unbounded or bounded, and each wait.
+template <typename T, typename WaitPolicy, typename Check>
+void forEachShapeWaitingWith(Check &check) {
+  constexpr auto many{ManyThreads};
+  check.template operator()<FreshQueue<T, Producers<1>, Consumers<1>,
+                                       Capacity<>, Wait<WaitPolicy>>>();
+  check.template operator()<FreshQueue<T, Producers<1>, Consumers<many>,
+                                       Capacity<>, Wait<WaitPolicy>>>();
+  check.template operator()<FreshQueue<T, Producers<many>, Consumers<1>,
+                                       Capacity<>, Wait<WaitPolicy>>>();
+  check.template operator()<FreshQueue<T, Producers<many>, Consumers<many>,
+                                       Capacity<>, Wait<WaitPolicy>>>();
+  check.template operator()<FreshQueue<T, Producers<1>, Consumers<1>,
+                                       Capacity<64>, Wait<WaitPolicy>>>();
+  check.template operator()<FreshQueue<T, Producers<1>, Consumers<many>,
+                                       Capacity<64>, Wait<WaitPolicy>>>();
+  check.template operator()<FreshQueue<T, Producers<many>, Consumers<1>,
+                                       Capacity<64>, Wait<WaitPolicy>>>();
+  check.template operator()<FreshQueue<T, Producers<many>, Consumers<many>,
+                                       Capacity<64>, Wait<WaitPolicy>>>();
+}
+
+template <typename T, typename Check> void forEachShape(Check check) {
+  forEachShapeWaitingWith<T, CondVarWait>(check);
+  forEachShapeWaitingWith<T, SpinYieldWait<>>(check);
+  forEachShapeWaitingWith<T, SpinAtomicWait<>>(check);
+}
+
+// Moves in without throwing but may throw when moved over, which the ring
+// queues cannot recover from.
+struct ThrowingMoveAssign {
+  ThrowingMoveAssign() = default;
+  ThrowingMoveAssign(ThrowingMoveAssign &&) noexcept = default;
+  ThrowingMoveAssign &operator=(ThrowingMoveAssign &&) noexcept(false) {
+    return *this;
+  }
+};
+} // namespace
+
+TEST(FreshQueue, backendFollowsDeclaredShape) {
+  constexpr auto many{ManyThreads};
+  static_assert(std::same_as<FreshQueue<int, Producers<1>, Consumers<1>,
+                                        Capacity<64>, Wait<SpinYieldWait<>>>::
+                                 Backend,
+                             SpscFreshQueue<int, 64>>);
+  static_assert(
+      std::same_as<FreshQueue<int, Producers<many>, Consumers<1>,
+                              Capacity<64>, Wait<BusySpinWait>>::Backend,
+                   LockFreeFreshQueue<int, 64>>);
+  static_assert(
+      std::same_as<FreshQueue<int, Producers<1>, Consumers<1>, Capacity<64>,
+                              Wait<SpinAtomicWait<>>>::Backend,
+                   ConcurrentFreshQueue<int, std::allocator<int>,
+                                        SpinAtomicWait<>>>);
+  static_assert(std::same_as<FreshQueue<int, Producers<1>, Consumers<1>,
+                                        Capacity<100>, Wait<SpinYieldWait<>>>::
+                                 Backend,
+                             ConcurrentFreshQueue<int, std::allocator<int>,
+                                                  SpinYieldWait<>>>);
+  static_assert(
+      std::same_as<FreshQueue<int, Producers<many>, Consumers<many>,
+                              Capacity<>, Wait<SpinAtomicWait<>>>::Backend,
+                   UnboundedLockFreeFreshQueue<int, SpinAtomicIdle<128>>>);
+  static_assert(std::same_as<FreshQueue<int>::Backend,
+                             SegmentedFreshQueue<int, 64, CondVarWait>>);
+  static_assert(
+      std::same_as<FreshQueue<int, Producers<1>, Consumers<many>, Capacity<>,
+                              Wait<SpinAtomicWait<>>>::Backend,
+                   SegmentedFreshQueue<int, 64, SpinAtomicWait<>>>);
+  static_assert(std::same_as<
+                FreshQueue<ThrowingMoveAssign, Producers<many>,
+                           Consumers<many>, Capacity<64>,
+                           Wait<SpinYieldWait<>>>::Backend,
+                ConcurrentFreshQueue<ThrowingMoveAssign,
+                                     std::allocator<ThrowingMoveAssign>,
+                                     SpinYieldWait<>>>);
+}
+
+TEST(FreshQueue, everyShapeHasTheSameCalls) {
+  forEachShape<int>([]<typename Queue>() {
+    Queue queue{};
+    int value{};
+    ASSERT_TRUE(queue.empty());
+    ASSERT_FALSE(queue.tryPop(value));
+    ASSERT_THROW(queue.pop(value), EmptyQueue);
+    const int two{2};
+    queue.push(1);
+    queue.push(two);
+    queue.emplace(3);
+    ASSERT_TRUE(queue.tryPush(4));
+    ASSERT_TRUE(queue.tryPush(two));
+    ASSERT_FALSE(queue.empty());
+    for (int expected : {1, 2, 3, 4, 2}) {
+      queue.waitAndPop(value);
+      ASSERT_EQ(value, expected);
+    }
+    ASSERT_TRUE(queue.empty());
+  });
+}
+
+TEST(FreshQueue, boundedTryPushFailsWhenFull) {
+  forEachShape<int>([]<typename Queue>() {
+    if constexpr (Queue::capacity() != UnboundedCapacity) {
+      Queue queue{};
+      for (int i{}; i < static_cast<int>(Queue::capacity()); ++i) {
+        ASSERT_TRUE(queue.tryPush(i));
+      }
+      ASSERT_FALSE(queue.tryPush(-1));
+      int value{};
+      queue.pop(value);
+      ASSERT_EQ(value, 0);
+      ASSERT_TRUE(queue.tryPush(-1));
+    }
+  });
+}
+
+TEST(FreshQueue, everyShapeHoldsMoveOnlyElements) {
+  forEachShape<std::unique_ptr<int>>([]<typename Queue>() {
+    Queue queue{};
+    queue.push(std::make_unique<int>(1));
+    queue.emplace(new int{2});
+    std::unique_ptr<int> value{};
+    queue.pop(value);
+    ASSERT_EQ(*value, 1);
+    queue.waitAndPop(value);
+    ASSERT_EQ(*value, 2);
+  });
+}
+
+TEST(FreshQueue, everyShapeMovesElementsAcrossThreads) {
+  forEachShape<int>([]<typename Queue>() {
+    constexpr int perProducer{3000};
+    const int producers{Queue::Shape::singleProducer ? 1 : 3};
+    const int consumers{Queue::Shape::singleConsumer ? 1 : 3};
+    Queue queue{};
+    std::atomic<long> sum{};
+    std::vector<std::thread> threads{};
+    for (int i{}; i < producers; ++i) {
+      threads.emplace_back([&] {
+        for (int value{1}; value <= perProducer; ++value) {
+          queue.push(value);
+        }
+      });
+    }
+    for (int i{}; i < consumers; ++i) {
+      threads.emplace_back([&] {
+        int value{};
+        for (int popped{}; popped < producers * perProducer / consumers;
+             ++popped) {
+          queue.waitAndPop(value);
+          sum += value;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    ASSERT_EQ(sum, static_cast<long>(producers) * perProducer *
+                       (perProducer + 1) / 2);
+    ASSERT_TRUE(queue.empty());
+  });
+}